@@ -0,0 +1,90 @@
+#include <iostream>
+#include <string>
+#include <chrono>
+#include <thread>
+#include "../include/deribitApi.h"
+#include "mockDeribit.h"
+
+using namespace std;
+using namespace std::chrono;
+using json = nlohmann::json;
+
+// Checks that a cancel which cannot be sent for want of valid credentials leaves the order alone:
+// over REST it reports the failure without reaching the exchange, and through the account cache
+// the order, marked cancelled when the request was queued, is back among the open orders once
+// the request fails. Exits non-zero otherwise, so it can run as a test.
+
+const string INSTRUMENT = "BTC-PERPETUAL";
+const uint16_t FIRST_PORT = 19330;        // Clear of the ports taken by bench and the other checks
+
+// Waits up to `timeout` for `done` to hold
+template <typename Predicate>
+bool waitFor(Predicate done, milliseconds timeout) {
+    auto deadline = steady_clock::now() + timeout;
+    while (!done()) {
+        if (steady_clock::now() >= deadline) return false;
+        this_thread::sleep_for(milliseconds(10));
+    }
+    return true;
+}
+
+int main() {
+    mockConfig config;
+    config.httpPort = FIRST_PORT;
+    config.wsPort = FIRST_PORT + 1;
+    mockDeribit mock(config);
+
+    // A resting order, placed while the credentials are still accepted
+    tradeManager trader(mock.env());
+    json placed = json::parse(trader.placeOrder(1, INSTRUMENT, 10, "limit"), nullptr, false);
+    string orderId = placed.is_discarded() ? "" : placed["result"]["order"].value("order_id", "");
+    if (orderId.empty()) {
+        cerr << "FAIL: could not place the resting order" << endl;
+        return 1;
+    }
+    auto restingOnExchange = [&] { return trader.getOpenOrders().find(orderId) != string::npos; };
+
+    unordered_map<string, string> env = mock.env();
+    env["DERIBIT_ACCOUNT_CACHE"] = "1";
+    tradeManager cached(env);
+    const accountState& account = *cached.accountCache();
+    auto openInCache = [&] {
+        orderRecord record;
+        return account.order(orderId, record) && record.isOpen() && !record.pending;
+    };
+    if (!waitFor([&] { return account.ready() && openInCache(); }, seconds(10))) {
+        cerr << "FAIL: the account cache never listed the resting order" << endl;
+        return 1;
+    }
+
+    mock.refuseAuth(true);
+    int status = 0;
+
+    // REST: no token, so nothing is sent
+    tradeManager unauthorized(mock.env());
+    string rest = unauthorized.cancelOrder(orderId);
+    if (rest != "Authorization Failed") {
+        cerr << "FAIL: the REST cancel without a token answered " << rest << endl;
+        status = 1;
+    }
+
+    // Order socket: the reconnect cannot authenticate, so the queued cancel fails
+    mock.dropConnections();
+    string ws = cached.cancelOrder(orderId);
+    if (ws.find("\"result\"") != string::npos) {
+        cerr << "FAIL: the cancel on an unauthenticated socket answered " << ws << endl;
+        status = 1;
+    }
+    if (!waitFor(openInCache, milliseconds(ORDER_RESPONSE_TIMEOUT_MS + 2000))) {
+        cerr << "FAIL: the account cache still hides the order after the cancel failed" << endl;
+        status = 1;
+    }
+
+    mock.refuseAuth(false);
+    if (!restingOnExchange()) {
+        cerr << "FAIL: the order was cancelled on the exchange" << endl;
+        status = 1;
+    }
+    cout << "rest_reply=" << rest << " ws_reply=" << ws << " order_open_in_cache=" << openInCache() << endl;
+    return status;
+}
@@ -0,0 +1,680 @@
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <future>
+#include <fstream>
+#include <mutex>
+#if !defined(_WIN32)
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+#include "../include/deribitApi.h"
+#include "../include/webServer.h"
+#include "../include/orderScheduler.h"
+#include "mockDeribit.h"
+
+using namespace std;
+using namespace std::chrono;
+using json = nlohmann::json;
+
+// Plain WebSocket client used for synthetic downstream subscribers
+using downstreamClient = websocketpp::client<websocketpp::config::asio_client>;
+
+const string INSTRUMENT = "BTC-PERPETUAL";
+const uint16_t FIRST_PORT = 19100;           // Mocks and servers take consecutive ports from here
+
+// Benchmark settings, overridable from the command line
+struct benchConfig {
+    size_t orders = 1000;                     // Orders per order-entry scenario
+    long latencyMs = 0;                       // Simulated exchange latency for order scenarios
+    long batchLatencyMs = 2;                  // Simulated latency for the sequential vs batch comparison
+    vector<size_t> subscribers = {1, 10, 100, 1000, 10000};
+    double seconds = 3;                       // Measurement window per fan-out run
+    long bookIntervalMs = 1;                  // Upstream change rate for fan-out runs
+    double rateLimit = 100;                   // Mock matching-engine requests per second
+    double rateBurst = 20;                    // Mock matching-engine burst
+    string lowLatencyCores;                   // Fan-out cores for a second, low-latency fan-out pass; empty skips it
+    size_t soakRounds = 0;                    // Client churn rounds in the soak scenario; 0 skips it
+};
+
+uint16_t nextPort = FIRST_PORT;
+
+mockConfig freshMock(long latencyMs) {
+    mockConfig config;
+    config.httpPort = nextPort++;
+    config.wsPort = nextPort++;
+    config.latencyMs = latencyMs;
+    return config;
+}
+
+void printResult(const string& name, size_t count, double seconds, const latencyHistogram& latency) {
+    json summary = latency.summary();
+    cout << left << setw(28) << name
+         << right << setw(10) << count
+         << setw(14) << fixed << setprecision(0) << (count / seconds)
+         << setw(12) << setprecision(1) << summary["p50_us"].get<double>()
+         << setw(12) << summary["p99_us"].get<double>()
+         << setw(12) << summary["p999_us"].get<double>() << endl;
+}
+
+void printHeader(const string& title) {
+    cout << endl << "== " << title << " ==" << endl;
+    cout << left << setw(28) << "scenario"
+         << right << setw(10) << "count"
+         << setw(14) << "per_sec"
+         << setw(12) << "p50_us"
+         << setw(12) << "p99_us"
+         << setw(12) << "p999_us" << endl;
+}
+
+// ------ Order Entry Scenarios ------
+
+// Sequential REST orders through tradeManager; also reports the cold first request
+void benchRestOrders(const benchConfig& config) {
+    mockDeribit mock(freshMock(config.latencyMs));
+    tradeManager trader(mock.env());
+
+    latencyHistogram cold;
+    auto start = steady_clock::now();
+    trader.getOrderBook(INSTRUMENT, 1);   // New connection: DNS + TCP connect
+    cold.record(steady_clock::now() - start);
+    trader.authenticate();
+
+    latencyHistogram latency;
+    start = steady_clock::now();
+    for (size_t i = 0; i < config.orders; ++i) {
+        auto sent = steady_clock::now();
+        trader.placeOrder(i % 2, INSTRUMENT, 10);
+        latency.record(steady_clock::now() - sent);
+    }
+    double elapsed = duration<double>(steady_clock::now() - start).count();
+
+    printHeader("REST order round trip (mock latency " + to_string(config.latencyMs) + " ms)");
+    printResult("rest.cold_first_request", 1, duration<double>(nanoseconds(cold.percentile(1))).count(), cold);
+    printResult("rest.placeOrder.warm", config.orders, elapsed, latency);
+}
+
+// The same burst sent one at a time and through submitBatch
+void benchBatch(const benchConfig& config) {
+    mockDeribit mock(freshMock(config.batchLatencyMs));
+    tradeManager trader(mock.env());
+    trader.authenticate();
+
+    size_t burst = min<size_t>(config.orders, 200);
+    vector<tradeOp> ops;
+    for (size_t i = 0; i < burst; ++i) ops.push_back(tradeOp::order(i % 2, INSTRUMENT, 10, "limit"));
+
+    latencyHistogram sequential;
+    auto start = steady_clock::now();
+    for (auto& op : ops) {
+        auto sent = steady_clock::now();
+        trader.placeOrder(op.method == "private/buy", INSTRUMENT, 10, "limit");
+        sequential.record(steady_clock::now() - sent);
+    }
+    double sequentialS = duration<double>(steady_clock::now() - start).count();
+
+    latencyHistogram batched;
+    start = steady_clock::now();
+    trader.submitBatch(ops, DEFAULT_BATCH_CONCURRENCY, [&](size_t, const string&) {
+        batched.record(steady_clock::now() - start);
+    });
+    double batchS = duration<double>(steady_clock::now() - start).count();
+
+    printHeader("Burst of " + to_string(burst) + " orders (mock latency " + to_string(config.batchLatencyMs) + " ms)");
+    printResult("rest.sequential", burst, sequentialS, sequential);
+    printResult("rest.submitBatch", burst, batchS, batched);
+}
+
+// Pulling a full set of resting quotes: one cancel per order id, then one cancel-by-instrument
+// on pre-warmed connections
+void benchQuotePull(const benchConfig& config) {
+    mockDeribit mock(freshMock(config.batchLatencyMs));
+    tradeManager trader(mock.env());
+    trader.prewarm();
+
+    size_t quotes = min<size_t>(config.orders, 200);
+    vector<tradeOp> ops;
+    for (size_t i = 0; i < quotes; ++i) ops.push_back(tradeOp::order(i % 2, INSTRUMENT, 10, "limit"));
+    auto rest = [&] {
+        static const jsonScanner fields{"result.order.order_id"};
+        vector<string> ids;
+        for (const string& response : trader.submitBatch(ops)) {
+            jsonValue id;
+            fields.scan(response, &id);
+            if (id.found()) ids.push_back(id.text());
+        }
+        return ids;
+    };
+
+    latencyHistogram each;
+    vector<string> ids = rest();
+    auto start = steady_clock::now();
+    for (auto& id : ids) trader.cancelOrder(id);
+    each.record(steady_clock::now() - start);
+    double eachS = duration<double>(steady_clock::now() - start).count();
+
+    latencyHistogram scoped;
+    ids = rest();
+    start = steady_clock::now();
+    trader.cancelOrders(cancelScope::instrument(INSTRUMENT));
+    scoped.record(steady_clock::now() - start);
+    double scopedS = duration<double>(steady_clock::now() - start).count();
+
+    printHeader("Pulling " + to_string(quotes) + " quotes (mock latency " + to_string(config.batchLatencyMs) + " ms)");
+    printResult("quotes.cancel_each", quotes, eachS, each);
+    printResult("quotes.cancel_by_instrument", ids.size(), scopedS, scoped);
+}
+
+// WebSocket order entry: one at a time, then all in flight at once
+void benchWsOrders(const benchConfig& config) {
+    mockDeribit mock(freshMock(config.latencyMs));
+    tradeManager trader(mock.env());
+    trader.useWebSocket();
+    trader.placeOrder(1, INSTRUMENT, 10);   // Connect and authenticate
+
+    latencyHistogram sequential;
+    auto start = steady_clock::now();
+    for (size_t i = 0; i < config.orders; ++i) {
+        auto sent = steady_clock::now();
+        trader.placeOrder(i % 2, INSTRUMENT, 10);
+        sequential.record(steady_clock::now() - sent);
+    }
+    double sequentialS = duration<double>(steady_clock::now() - start).count();
+
+    latencyHistogram pipelined;
+    vector<future<string>> responses;
+    responses.reserve(config.orders);
+    start = steady_clock::now();
+    for (size_t i = 0; i < config.orders; ++i) {
+        responses.push_back(trader.placeOrderAsync(i % 2, INSTRUMENT, 10));
+    }
+    for (auto& response : responses) {
+        response.wait();
+        pipelined.record(steady_clock::now() - start);
+    }
+    double pipelinedS = duration<double>(steady_clock::now() - start).count();
+
+    printHeader("WebSocket order entry (mock latency " + to_string(config.latencyMs) + " ms)");
+    printResult("ws.placeOrder.sequential", config.orders, sequentialS, sequential);
+    printResult("ws.placeOrderAsync.inflight", config.orders, pipelinedS, pipelined);
+}
+
+// ------ Rate-Limited Order Stream ------
+
+// Connects and authenticates the order WebSocket with a request that uses no matching-engine credit
+void warmWebSocket(tradeManager& trader) {
+    promise<void> ready;
+    trader.submitAsync(tradeOp::orderBook(INSTRUMENT, 1), [&ready](const string&) { ready.set_value(); });
+    ready.get_future().wait();
+}
+
+mockConfig rateLimitedMock(const benchConfig& config) {
+    mockConfig limited = freshMock(config.latencyMs);
+    limited.matchingRate = config.rateLimit;
+    limited.matchingBurst = config.rateBurst;
+    return limited;
+}
+
+// The same stream of orders against the mock's matching-engine limit: sent as a burst with
+// retries after each too_many_requests, then paced by orderScheduler
+void benchScheduler(const benchConfig& config) {
+    size_t count = (size_t)(config.rateBurst + config.rateLimit * config.seconds);
+    const long retryMs = 50;
+
+    latencyHistogram naive;
+    size_t naiveRejected = 0;
+    double naiveS = 0;
+    {
+        mockDeribit mock(rateLimitedMock(config));
+        tradeManager trader(mock.env());
+        warmWebSocket(trader);
+
+        size_t pending = count;
+        auto start = steady_clock::now();
+        while (pending > 0) {
+            vector<future<string>> responses;
+            for (size_t i = 0; i < pending; ++i) responses.push_back(trader.placeOrderAsync(i % 2, INSTRUMENT, 10));
+            pending = 0;
+            for (auto& response : responses) {
+                if (response.get().find("too_many_requests") != string::npos) ++pending;
+                else naive.record(steady_clock::now() - start);
+            }
+            if (pending > 0) this_thread::sleep_for(milliseconds(retryMs));
+        }
+        naiveS = duration<double>(steady_clock::now() - start).count();
+        naiveRejected = mock.rejected();
+    }
+
+    latencyHistogram paced;
+    size_t pacedRejected = 0;
+    double pacedS = 0;
+    {
+        mockDeribit mock(rateLimitedMock(config));
+        tradeManager trader(mock.env());
+        warmWebSocket(trader);
+
+        schedulerConfig limits;
+        limits.matching = {config.rateBurst, config.rateLimit, 1};
+        orderScheduler scheduler(trader, limits);
+        auto start = steady_clock::now();
+        for (size_t i = 0; i < count; ++i) {
+            scheduler.submit(tradeOp::order(i % 2, INSTRUMENT, 10, "market"), [&paced, start](const string&) {
+                paced.record(steady_clock::now() - start);
+            });
+        }
+        scheduler.drain();
+        pacedS = duration<double>(steady_clock::now() - start).count();
+        pacedRejected = mock.rejected();
+    }
+
+    printHeader(to_string(count) + " orders against a " + to_string((int)config.rateLimit) + "/s limit (burst "
+                + to_string((int)config.rateBurst) + ", mock latency " + to_string(config.latencyMs) + " ms)");
+    printResult("ratelimit.burst_and_retry", count, naiveS, naive);
+    cout << "    too_many_requests=" << naiveRejected << endl;
+    printResult("ratelimit.orderScheduler", count, pacedS, paced);
+    cout << "    too_many_requests=" << pacedRejected << endl;
+}
+
+// ------ Pre-trade Risk Checks ------
+
+// Cost of one inline check with every limit enabled, for orders that pass (including giving
+// back their working exposure) and for each way of failing, next to the exchange round trip
+// a rejected order would otherwise cost
+void benchRisk(const benchConfig& config) {
+    riskLimits limits;
+    limits.maxOrderAmount = 1000;
+    limits.maxPosition = 5000;
+    limits.maxNotional = 1000;
+    limits.inverse = true;
+    limits.priceCollarPct = 1;
+    limits.maxOrdersPerSecond = 1e9;          // Throttle evaluated on every call but never binding
+    limits.burst = 1e6;
+    riskEngine engine;
+    engine.addInstrument(INSTRUMENT, limits);
+    engine.setQuote(INSTRUMENT, 50000, 50010);
+
+    struct riskCase {
+        string name;
+        double amount;
+        double price;
+    };
+    const vector<riskCase> cases = {
+        {"risk.accepted", 10, 50000},
+        {"risk.max_order_amount", 2000, 50000},
+        {"risk.price_collar", 10, 60000},
+    };
+    const size_t checks = max<size_t>(config.orders, 1) * 1000;
+
+    cout << endl << "== Pre-trade risk check, " << checks << " checks per case ==" << endl;
+    for (const riskCase& test : cases) {
+        size_t accepted = 0;
+        auto start = steady_clock::now();
+        for (size_t i = 0; i < checks; ++i) {
+            if (engine.check(INSTRUMENT, i % 2, test.amount, test.price) != riskVerdict::accepted) continue;
+            engine.release(INSTRUMENT, i % 2, test.amount);   // Answered: the reservation goes back
+            ++accepted;
+        }
+        double ns = duration<double, nano>(steady_clock::now() - start).count() / checks;
+        cout << left << setw(28) << test.name << right << setw(10) << fixed << setprecision(1) << ns
+             << " ns/check  accepted=" << accepted << endl;
+    }
+
+    mockDeribit mock(freshMock(config.latencyMs));
+    tradeManager trader(mock.env());
+    warmWebSocket(trader);
+    latencyHistogram roundTrip;
+    auto start = steady_clock::now();
+    for (size_t i = 0; i < config.orders; ++i) {
+        auto sent = steady_clock::now();
+        trader.placeOrderAsync(i % 2, INSTRUMENT, 10).get();
+        roundTrip.record(steady_clock::now() - sent);
+    }
+    double elapsedS = duration<double>(steady_clock::now() - start).count();
+    printHeader("Exchange round trip a local reject saves (mock latency " + to_string(config.latencyMs) + " ms)");
+    printResult("ws.order_round_trip", config.orders, elapsedS, roundTrip);
+}
+
+// ------ Order Book Snapshots ------
+
+// Strategy threads asking for the same book at once: every call a REST request, then through
+// the single-flight snapshot cache with only coalescing (0 ms) and with a 100 ms budget
+void benchBookCache(const benchConfig& config) {
+    const size_t threads = 8;
+    const size_t perThread = max<size_t>(1, config.orders / threads);
+    printHeader(to_string(threads) + " threads reading one book (mock latency " + to_string(config.batchLatencyMs) + " ms)");
+
+    for (long long ttlMs : {-1LL, 0LL, 100LL}) {
+        mockDeribit mock(freshMock(config.batchLatencyMs));
+        unordered_map<string, string> env = mock.env();
+        if (ttlMs >= 0) env["DERIBIT_BOOK_CACHE_MS"] = to_string(ttlMs);
+        tradeManager trader(env);
+        trader.getOrderBook(INSTRUMENT, 5);   // Warm the connection pool
+
+        latencyHistogram latency;
+        vector<thread> workers;
+        auto start = steady_clock::now();
+        for (size_t t = 0; t < threads; ++t) {
+            workers.emplace_back([&] {
+                for (size_t i = 0; i < perThread; ++i) {
+                    auto sent = steady_clock::now();
+                    trader.getOrderBook(INSTRUMENT, 5);
+                    latency.record(steady_clock::now() - sent);
+                }
+            });
+        }
+        for (auto& worker : workers) worker.join();
+        double elapsed = duration<double>(steady_clock::now() - start).count();
+
+        string name = (ttlMs < 0) ? "book.rest" : "book.snapshotCache." + to_string(ttlMs) + "ms";
+        printResult(name, threads * perThread, elapsed, latency);
+        if (const snapshotCache* cache = trader.bookCache()) {
+            cout << "    requests=" << cache->fetched() - 1 << " coalesced=" << cache->coalesced()
+                 << " hits=" << cache->hits() << endl;
+        }
+    }
+}
+
+// ------ Market Data Fan-out ------
+
+// Largest subscriber count the descriptor limit allows (each costs a client and a server socket)
+size_t raiseDescriptorLimit(size_t wanted) {
+#if !defined(_WIN32)
+    rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0) {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+        getrlimit(RLIMIT_NOFILE, &limit);
+        size_t allowed = (limit.rlim_cur > 256) ? (limit.rlim_cur - 256) / 2 : 1;
+        return min(wanted, allowed);
+    }
+#endif
+    return wanted;
+}
+
+// `lowLatency` runs the server with pinned polling ingest and fan-out threads
+void benchFanout(const benchConfig& config, size_t wanted, bool lowLatency) {
+    size_t subscribers = raiseDescriptorLimit(wanted);
+
+    mockConfig upstream = freshMock(0);
+    upstream.bookIntervalMs = config.bookIntervalMs;
+    mockDeribit mock(upstream);
+
+    unordered_map<string, string> env = mock.env();
+    if (lowLatency) {
+        env["LOW_LATENCY_MODE"] = "1";
+        env["LOW_LATENCY_FANOUT_CORES"] = config.lowLatencyCores;
+    }
+    orderBookServer server(env);
+    uint16_t port = nextPort++;
+    server.listen(port);
+    thread serverThread([&server] { server.run(); });
+
+    downstreamClient clients;
+    clients.clear_access_channels(websocketpp::log::alevel::all);
+    clients.clear_error_channels(websocketpp::log::elevel::all);
+    clients.init_asio();
+    clients.start_perpetual();
+
+    atomic<size_t> opened{0};
+    atomic<uint64_t> received{0};
+    string subscribe = json{
+        {"method", "subscribe"},
+        {"symbol", INSTRUMENT},
+        {"depth", 10},
+        {"interval", "100ms"}
+    }.dump();
+    clients.set_open_handler([&](websocketpp::connection_hdl hdl) {
+        websocketpp::lib::error_code ec;
+        clients.send(hdl, subscribe, websocketpp::frame::opcode::text, ec);
+        ++opened;
+    });
+    clients.set_message_handler([&](websocketpp::connection_hdl, downstreamClient::message_ptr) {
+        received.fetch_add(1, memory_order_relaxed);
+    });
+
+    for (size_t i = 0; i < subscribers; ++i) {
+        websocketpp::lib::error_code ec;
+        auto con = clients.get_connection("ws://127.0.0.1:" + to_string(port), ec);
+        if (!ec) clients.connect(con);
+    }
+    thread clientThread([&clients] { clients.run(); });
+
+    auto deadline = steady_clock::now() + seconds(30);
+    while (opened < subscribers && steady_clock::now() < deadline) {
+        this_thread::sleep_for(milliseconds(10));
+    }
+    this_thread::sleep_for(milliseconds(200));  // Let snapshots settle
+
+    latencyHistogram& upstreamToSend = latencyStats().histogram("server.upstream_to_send");
+    upstreamToSend.reset();
+    received = 0;
+    auto start = steady_clock::now();
+    this_thread::sleep_for(duration<double>(config.seconds));
+    uint64_t delivered = received.load();
+    double elapsed = duration<double>(steady_clock::now() - start).count();
+    json fanout = server.fanout_stats();
+
+    printResult(string(lowLatency ? "fanout.lowlatency." : "fanout.") + to_string(opened.load()) + "_subscribers",
+                delivered, elapsed, upstreamToSend);
+    cout << "    conflated=" << fanout["conflated"] << " dropped=" << fanout["dropped"]
+         << " max_queue_depth=" << fanout["max_queue_depth"] << endl;
+
+    clients.stop_perpetual();
+    clients.stop();
+    server.stop();
+    clientThread.join();
+    serverThread.join();
+}
+
+// ------ Soak ------
+
+// Resident set size of this process in KB (0 where /proc is not available)
+size_t residentKb() {
+#if defined(__linux__)
+    ifstream statm("/proc/self/statm");
+    size_t pages = 0, resident = 0;
+    if (statm >> pages >> resident) return resident * (size_t)sysconf(_SC_PAGESIZE) / 1024;
+#endif
+    return 0;
+}
+
+// CPU time used by this process so far, in microseconds
+double cpuMicros() {
+#if !defined(_WIN32)
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1e6 + usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+#else
+    return 0;
+#endif
+}
+
+const size_t SOAK_RSS_SLACK_KB = 8192;        // RSS growth over the warmed-up baseline still taken as flat
+
+// Client churn against one long-running server. Every round connects a wave of clients, each
+// subscribing to a symbol never used before (JSON or binary, book or analytics), lets them
+// receive for a moment and disconnects them all. Memory, CPU per delivered update and the
+// registry sizes are printed at checkpoints. Returns false, after saying why, unless every
+// registry size is back at its value before the first wave and RSS is back within
+// SOAK_RSS_SLACK_KB of its value after the first wave (which warms up pools and allocators).
+bool benchSoak(const benchConfig& config) {
+    const size_t wave = 50;
+    const size_t symbolsPerWave = 10;
+
+    mockConfig upstream = freshMock(0);
+    upstream.bookIntervalMs = config.bookIntervalMs;
+    mockDeribit mock(upstream);
+    orderBookServer server(mock.env());
+    uint16_t port = nextPort++;
+    server.listen(port);
+    thread serverThread([&server] { server.run(); });
+
+    downstreamClient clients;
+    clients.clear_access_channels(websocketpp::log::alevel::all);
+    clients.clear_error_channels(websocketpp::log::elevel::all);
+    clients.init_asio();
+    clients.start_perpetual();
+    atomic<uint64_t> received{0};
+    atomic<size_t> opened{0}, closed{0};
+    clients.set_message_handler([&](websocketpp::connection_hdl, downstreamClient::message_ptr) {
+        received.fetch_add(1, memory_order_relaxed);
+    });
+    clients.set_close_handler([&](websocketpp::connection_hdl) { ++closed; });
+    clients.set_fail_handler([&](websocketpp::connection_hdl) { ++closed; });
+    thread clientThread([&clients] { clients.run(); });
+
+    cout << endl << "== Soak: " << config.soakRounds << " rounds of " << wave << " clients ==" << endl;
+    cout << left << setw(10) << "round" << right << setw(10) << "rss_kb" << setw(14) << "cpu_us/update"
+         << setw(10) << "topics" << setw(13) << "instruments" << setw(10) << "channels" << setw(11) << "upstreams" << endl;
+    auto report = [&](const string& label, double cpuPerUpdate) {
+        json registry = server.registry_stats();
+        cout << left << setw(10) << label << right << setw(10) << residentKb()
+             << setw(14) << fixed << setprecision(2) << cpuPerUpdate
+             << setw(10) << registry["topics"].get<size_t>() << setw(13) << registry["instruments"].get<size_t>()
+             << setw(10) << registry["upstream_channels"].get<size_t>()
+             << setw(11) << registry["upstream_connected"].get<size_t>() << endl;
+    };
+
+    json baseline = server.registry_stats();
+    size_t baselineKb = 0;
+    size_t checkpoint = max<size_t>(1, config.soakRounds / 10);
+    double cpuStart = cpuMicros();
+    uint64_t receivedStart = 0;
+    for (size_t round = 0; round < config.soakRounds; ++round) {
+        struct openedClients {
+            mutex mutex_;
+            vector<websocketpp::connection_hdl> handles;
+        };
+        auto current = make_shared<openedClients>();   // Outlives the round if a client opens late
+        opened = 0;
+        closed = 0;
+        for (size_t i = 0; i < wave; ++i) {
+            websocketpp::lib::error_code ec;
+            auto con = clients.get_connection("ws://127.0.0.1:" + to_string(port), ec);
+            if (ec) continue;
+            if (i % 2) con->add_subprotocol(BOOK_FRAME_PROTOCOL);
+            string subscribe = json{
+                {"method", "subscribe"},
+                {"symbol", "SOAK" + to_string(round) + "-" + to_string(i % symbolsPerWave)},
+                {"depth", 5},
+                {"interval", "100ms"},
+                {"channel", (i % 4 < 2) ? "book" : "analytics"}
+            }.dump();
+            con->set_open_handler([&clients, &opened, current, subscribe](websocketpp::connection_hdl hdl) {
+                websocketpp::lib::error_code sendEc;
+                clients.send(hdl, subscribe, websocketpp::frame::opcode::text, sendEc);
+                lock_guard<mutex> lock(current->mutex_);
+                current->handles.push_back(hdl);
+                ++opened;
+            });
+            clients.connect(con);
+        }
+
+        auto deadline = steady_clock::now() + seconds(10);
+        while (opened + closed < wave && steady_clock::now() < deadline) this_thread::sleep_for(milliseconds(5));
+        this_thread::sleep_for(milliseconds(200));   // Receive for a while
+        {
+            lock_guard<mutex> lock(current->mutex_);
+            for (auto& hdl : current->handles) {
+                websocketpp::lib::error_code ec;
+                clients.close(hdl, websocketpp::close::status::normal, "Soak round over", ec);
+            }
+        }
+        deadline = steady_clock::now() + seconds(10);
+        while (closed < wave && steady_clock::now() < deadline) this_thread::sleep_for(milliseconds(5));
+        if (round == 0) baselineKb = residentKb();
+
+        if ((round + 1) % checkpoint == 0) {
+            double cpuNow = cpuMicros();
+            uint64_t receivedNow = received.load();
+            uint64_t updates = receivedNow - receivedStart;
+            report(to_string(round + 1), updates ? (cpuNow - cpuStart) / updates : 0.0);
+            cpuStart = cpuNow;
+            receivedStart = receivedNow;
+        }
+    }
+
+    // Let the last unsubscribes reach the server and its upstream sessions wind down
+    auto deadline = steady_clock::now() + seconds(5);
+    while (server.registry_stats() != baseline && steady_clock::now() < deadline) this_thread::sleep_for(milliseconds(50));
+    report("idle", 0);
+
+    bool flat = true;
+    json idle = server.registry_stats();
+    for (auto& entry : baseline.items()) {
+        if (idle[entry.key()] != entry.value()) {
+            cerr << "FAIL: soak registry " << entry.key() << " is " << idle[entry.key()]
+                 << " when idle, " << entry.value() << " before the first wave" << endl;
+            flat = false;
+        }
+    }
+    size_t idleKb = residentKb();
+    if (baselineKb && idleKb > baselineKb + SOAK_RSS_SLACK_KB) {
+        cerr << "FAIL: soak RSS is " << idleKb << " KB when idle, " << baselineKb
+             << " KB after the first wave" << endl;
+        flat = false;
+    }
+
+    clients.stop_perpetual();
+    clients.stop();
+    server.stop();
+    clientThread.join();
+    serverThread.join();
+    return flat;
+}
+
+// ------ Entry Point ------
+
+vector<size_t> parseList(const string& text) {
+    vector<size_t> values;
+    stringstream in(text);
+    string item;
+    while (getline(in, item, ',')) {
+        if (!item.empty()) values.push_back(stoul(item));
+    }
+    return values;
+}
+
+int main(int argc, char** argv) {
+    benchConfig config;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        string flag = argv[i];
+        string value = argv[i + 1];
+        if (flag == "--orders") config.orders = stoul(value);
+        else if (flag == "--latency-ms") config.latencyMs = stol(value);
+        else if (flag == "--batch-latency-ms") config.batchLatencyMs = stol(value);
+        else if (flag == "--subscribers") config.subscribers = parseList(value);
+        else if (flag == "--seconds") config.seconds = stod(value);
+        else if (flag == "--book-interval-ms") config.bookIntervalMs = stol(value);
+        else if (flag == "--rate-limit") config.rateLimit = stod(value);
+        else if (flag == "--rate-burst") config.rateBurst = stod(value);
+        else if (flag == "--low-latency-cores") config.lowLatencyCores = value;
+        else if (flag == "--soak-rounds") config.soakRounds = stoul(value);
+        else {
+            cerr << "Unknown option: " << flag << endl;
+            return 1;
+        }
+    }
+
+    benchRestOrders(config);
+    benchBatch(config);
+    benchQuotePull(config);
+    benchWsOrders(config);
+    benchScheduler(config);
+    benchRisk(config);
+    benchBookCache(config);
+
+    printHeader("Market data fan-out, upstream -> client socket (book change every "
+                + to_string(config.bookIntervalMs) + " ms)");
+    for (size_t subscribers : config.subscribers) {
+        benchFanout(config, subscribers, false);
+        if (!config.lowLatencyCores.empty()) benchFanout(config, subscribers, true);
+    }
+    if (config.soakRounds && !benchSoak(config)) return 1;
+    return 0;
+}
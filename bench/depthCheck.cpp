@@ -0,0 +1,104 @@
+#include <iostream>
+#include <string>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include "../include/webServer.h"
+#include "mockDeribit.h"
+
+using namespace std;
+using namespace std::chrono;
+using json = nlohmann::json;
+
+// Checks that a subscribe asking for more than MAX_SUBSCRIPTION_DEPTH levels is refused with an
+// error reply and creates no group, while the same client's next, valid subscribe is served.
+// Exits non-zero otherwise, so it can run as a test.
+
+using downstreamClient = websocketpp::client<websocketpp::config::asio_client>;
+
+const string INSTRUMENT = "BTC-PERPETUAL";
+const uint16_t FIRST_PORT = 19320;        // Clear of the ports taken by bench and the other checks
+
+int main() {
+    mockConfig upstream;
+    upstream.httpPort = FIRST_PORT;
+    upstream.wsPort = FIRST_PORT + 1;
+    mockDeribit mock(upstream);
+
+    orderBookServer server(mock.env());
+    uint16_t port = FIRST_PORT + 2;
+    server.listen(port);
+    thread serverThread([&server] { server.run(); });
+
+    mutex repliesMutex;
+    vector<json> replies;                 // Text replies, in order
+
+    downstreamClient client;
+    client.clear_access_channels(websocketpp::log::alevel::all);
+    client.clear_error_channels(websocketpp::log::elevel::all);
+    client.init_asio();
+    client.start_perpetual();
+    client.set_open_handler([&client](websocketpp::connection_hdl hdl) {
+        websocketpp::lib::error_code ec;
+        for (long long depth : {2000000000LL, 10LL}) {
+            string subscribe = json{{"method", "subscribe"}, {"symbol", INSTRUMENT}, {"depth", depth}, {"interval", "100ms"}}.dump();
+            client.send(hdl, subscribe, websocketpp::frame::opcode::text, ec);
+        }
+    });
+    client.set_message_handler([&](websocketpp::connection_hdl, downstreamClient::message_ptr msg) {
+        if (msg->get_opcode() != websocketpp::frame::opcode::text) return;   // Book frames
+        json reply = json::parse(msg->get_payload(), nullptr, false);
+        lock_guard<mutex> lock(repliesMutex);
+        replies.push_back(reply);
+    });
+
+    websocketpp::lib::error_code ec;
+    auto con = client.get_connection("ws://127.0.0.1:" + to_string(port), ec);
+    if (ec) {
+        cerr << "FAIL: " << ec.message() << endl;
+        server.stop();
+        serverThread.join();
+        return 1;
+    }
+    con->add_subprotocol(BOOK_FRAME_PROTOCOL);   // Binary clients are told what they subscribed to
+    client.connect(con);
+    thread clientThread([&client] { client.run(); });
+
+    auto deadline = steady_clock::now() + seconds(10);
+    while (steady_clock::now() < deadline) {
+        {
+            lock_guard<mutex> lock(repliesMutex);
+            if (replies.size() >= 2) break;
+        }
+        this_thread::sleep_for(milliseconds(10));
+    }
+    size_t topics = server.registry_stats()["topics"].get<size_t>();
+
+    client.stop_perpetual();
+    client.stop();
+    server.stop();
+    clientThread.join();
+    serverThread.join();
+
+    int status = 0;
+    lock_guard<mutex> lock(repliesMutex);
+    if (replies.size() < 2) {
+        cerr << "FAIL: expected two replies, got " << replies.size() << endl;
+        return 1;
+    }
+    cout << "first_reply=" << replies[0].dump() << " second_reply=" << replies[1].dump() << " topics=" << topics << endl;
+    if (!replies[0].contains("error")) {
+        cerr << "FAIL: the oversized depth was not refused" << endl;
+        status = 1;
+    }
+    if (replies[1].value("method", "") != "subscribed" || replies[1].value("depth", 0) != 10) {
+        cerr << "FAIL: the valid subscribe after the refused one was not served" << endl;
+        status = 1;
+    }
+    if (topics != 1) {
+        cerr << "FAIL: " << topics << " groups running, expected only the valid one" << endl;
+        status = 1;
+    }
+    return status;
+}
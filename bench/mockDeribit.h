@@ -0,0 +1,736 @@
+#pragma once
+#include <iostream>
+#include <string>
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <set>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include <future>
+#include <asio.hpp>
+#include <openssl/evp.h>
+#include <openssl/rsa.h>
+#include <openssl/x509.h>
+#include <websocketpp/config/asio.hpp>
+#include <websocketpp/server.hpp>
+#include <nlohmann/json.hpp>
+
+using namespace std;
+using json = nlohmann::json;
+using asio::ip::tcp;
+
+using mockWsServer = websocketpp::server<websocketpp::config::asio_tls>;
+
+// Mock exchange settings
+struct mockConfig {
+    uint16_t httpPort = 18443;     // REST endpoint: http://127.0.0.1:<httpPort>/api/v2/
+    uint16_t wsPort = 18444;       // WebSocket endpoint: wss://127.0.0.1:<wsPort>/ws/api/v2
+    long latencyMs = 0;            // Delay added before every response
+    size_t bookDepth = 10;         // Levels per side in books, snapshots and get_order_book
+    size_t paddingBytes = 0;       // Extra bytes appended to every response
+    long bookIntervalMs = 100;     // Period of book change notifications
+    size_t levelsPerChange = 2;    // Levels touched by each change notification
+    double matchingRate = 0;       // Matching-engine requests refilled per second; 0 = unlimited
+    double matchingBurst = 20;     // Matching-engine requests allowed back to back
+    size_t gapEvery = 0;           // Every Nth book change skips a change_id, as if one was lost; 0 = never
+};
+
+// ======== mockExchange Class ========
+// Deribit-shaped JSON-RPC handlers shared by the HTTP and WebSocket front ends:
+// public/auth, public/test, private/buy|sell|cancel|edit, private/cancel_all,
+// private/cancel_all_by_instrument|currency, private/cancel_by_label, public/get_order_book,
+// private/get_positions, private/get_open_orders and private/get_order_state.
+// Market orders fill immediately; limit orders rest until cancelled. With matchingRate set,
+// order, edit and cancel requests draw from a token bucket and are rejected with
+// too_many_requests (10028) when it is empty, as Deribit does.
+class mockExchange {
+    public:
+        explicit mockExchange(const mockConfig& config) : config_(config) {}
+
+        // Full JSON-RPC response for one request
+        json handle(const json& request) {
+            string method = request.value("method", "");
+            json params = request.value("params", json::object());
+
+            json response = {{"jsonrpc", "2.0"}};
+            if (request.contains("id")) response["id"] = request["id"];
+
+            json result;
+            json error;
+            {
+                lock_guard<mutex> lock(mutex_);
+                if (isMatching(method) && !takeMatchingCredit()) {
+                    ++rejected_;
+                    response["error"] = {{"code", 10028}, {"message", "too_many_requests"}};
+                    return response;
+                }
+                if (method == "public/auth") {
+                    if (refuseAuth_) error = {{"code", 13004}, {"message", "invalid_credentials"}};
+                    else result = auth();
+                }
+                else if (method == "private/buy") result = order("buy", params, error);
+                else if (method == "private/sell") result = order("sell", params, error);
+                else if (method == "private/cancel") result = cancel(params, error);
+                else if (method == "private/edit") result = edit(params, error);
+                else if (method == "private/cancel_all") result = cancelAll("", "");
+                else if (method == "private/cancel_all_by_instrument") result = cancelAll("instrument_name", params.value("instrument_name", ""));
+                else if (method == "private/cancel_all_by_currency") result = cancelAll("currency", params.value("currency", ""));
+                else if (method == "private/cancel_by_label") result = cancelAll("label", params.value("label", ""));
+                else if (method == "public/test") result = {{"version", "mock"}};
+                else if (method == "public/get_order_book") result = orderBook(params);
+                else if (method == "private/get_positions") result = positions();
+                else if (method == "private/get_open_orders") result = openOrders();
+                else if (method == "private/get_order_state") result = orderState(params, error);
+                else error = {{"code", -32601}, {"message", "Method not found"}};
+            }
+
+            if (!error.is_null()) response["error"] = error;
+            else response["result"] = result;
+            if (config_.paddingBytes) response["padding"] = string(config_.paddingBytes, 'x');
+            return response;
+        }
+
+        const mockConfig& config() const {
+            return config_;
+        }
+
+        // Requests rejected with too_many_requests so far
+        size_t rejected() {
+            lock_guard<mutex> lock(mutex_);
+            return rejected_;
+        }
+
+        // Answers public/auth with invalid_credentials while set, as for a revoked API key
+        void refuseAuth(bool refuse) {
+            lock_guard<mutex> lock(mutex_);
+            refuseAuth_ = refuse;
+        }
+
+    private:
+        mockConfig config_;
+        mutex mutex_;                              // Protects the state below
+        long long nextOrderId_ = 1;
+        long long nextTradeId_ = 1;
+        unordered_map<string, json> orders_;       // <Order id, Open order>
+        map<string, double> positions_;            // <Instrument, Signed size>
+        double matchingCredits_ = -1;              // Requests left in the bucket; -1 until first use
+        chrono::steady_clock::time_point matchingRefilled_;
+        size_t rejected_ = 0;
+        bool refuseAuth_ = false;
+
+        static bool isMatching(const string& method) {
+            return method == "private/buy" || method == "private/sell" || method == "private/edit"
+                || method == "private/cancel" || method.rfind("private/cancel_all", 0) == 0
+                || method == "private/cancel_by_label";
+        }
+
+        bool takeMatchingCredit() {
+            if (config_.matchingRate <= 0) return true;
+            auto now = chrono::steady_clock::now();
+            if (matchingCredits_ < 0) {
+                matchingCredits_ = config_.matchingBurst;
+            } else {
+                double elapsed = chrono::duration<double>(now - matchingRefilled_).count();
+                matchingCredits_ = min(config_.matchingBurst, matchingCredits_ + elapsed * config_.matchingRate);
+            }
+            matchingRefilled_ = now;
+            if (matchingCredits_ < 1) return false;
+            matchingCredits_ -= 1;
+            return true;
+        }
+
+        json auth() {
+            return {
+                {"access_token", "mock-access-token"},
+                {"refresh_token", "mock-refresh-token"},
+                {"expires_in", 900},
+                {"scope", "connection"},
+                {"token_type", "bearer"}
+            };
+        }
+
+        json order(const string& direction, const json& params, json& error) {
+            if (!params.contains("instrument_name") || !params.contains("amount")) {
+                error = {{"code", -32602}, {"message", "Invalid params"}};
+                return nullptr;
+            }
+            string instrument = params["instrument_name"];
+            double amount = params["amount"].get<double>();
+            string type = params.value("type", "limit");
+            double price = params.value("price", 50000.0);
+            string orderId = "MOCK-" + to_string(nextOrderId_++);
+
+            json order = {
+                {"order_id", orderId},
+                {"instrument_name", instrument},
+                {"direction", direction},
+                {"amount", amount},
+                {"price", price},
+                {"order_type", type},
+                {"label", params.value("label", "")},
+                {"creation_timestamp", nowMs()}
+            };
+            json trades = json::array();
+            if (type == "market") {
+                order["order_state"] = "filled";
+                order["filled_amount"] = amount;
+                trades.push_back({
+                    {"trade_id", "MOCK-T" + to_string(nextTradeId_++)},
+                    {"order_id", orderId},
+                    {"instrument_name", instrument},
+                    {"direction", direction},
+                    {"amount", amount},
+                    {"price", price}
+                });
+                positions_[instrument] += (direction == "buy") ? amount : -amount;
+            } else {
+                order["order_state"] = "open";
+                order["filled_amount"] = 0;
+                orders_[orderId] = order;
+            }
+            return {{"order", order}, {"trades", trades}};
+        }
+
+        json cancel(const json& params, json& error) {
+            auto it = orders_.find(params.value("order_id", ""));
+            if (it == orders_.end()) {
+                error = {{"code", 11044}, {"message", "not_open_order"}};
+                return nullptr;
+            }
+            json order = it->second;
+            order["order_state"] = "cancelled";
+            orders_.erase(it);
+            return order;
+        }
+
+        // Cancels every open order whose `field` is `value` (all of them for an empty field)
+        // and returns how many there were
+        json cancelAll(const string& field, const string& value) {
+            size_t cancelled = 0;
+            for (auto it = orders_.begin(); it != orders_.end();) {
+                bool match = field.empty()
+                    || (field == "currency" ? it->second["instrument_name"].get<string>().rfind(value, 0) == 0
+                                            : it->second.value(field, "") == value);
+                if (match) {
+                    it = orders_.erase(it);
+                    ++cancelled;
+                } else {
+                    ++it;
+                }
+            }
+            return cancelled;
+        }
+
+        json edit(const json& params, json& error) {
+            auto it = orders_.find(params.value("order_id", ""));
+            if (it == orders_.end()) {
+                error = {{"code", 11044}, {"message", "not_open_order"}};
+                return nullptr;
+            }
+            if (params.contains("amount")) it->second["amount"] = params["amount"];
+            if (params.contains("price")) it->second["price"] = params["price"];
+            return {{"order", it->second}, {"trades", json::array()}};
+        }
+
+        json orderBook(const json& params) {
+            size_t depth = params.value("depth", (int)config_.bookDepth);
+            json bids = json::array();
+            json asks = json::array();
+            for (size_t i = 0; i < depth; ++i) {
+                bids.push_back({50000.0 - 0.5 * (i + 1), 100.0});
+                asks.push_back({50000.0 + 0.5 * (i + 1), 100.0});
+            }
+            return {
+                {"instrument_name", params.value("instrument_name", "")},
+                {"timestamp", nowMs()},
+                {"change_id", 1},
+                {"bids", bids},
+                {"asks", asks},
+                {"best_bid_price", bids.empty() ? 0.0 : bids[0][0].get<double>()},
+                {"best_ask_price", asks.empty() ? 0.0 : asks[0][0].get<double>()}
+            };
+        }
+
+        json openOrders() {
+            json out = json::array();
+            for (auto& entry : orders_) out.push_back(entry.second);
+            return out;
+        }
+
+        // Only resting orders are kept, so filled and cancelled ones are reported as not found
+        json orderState(const json& params, json& error) {
+            auto it = orders_.find(params.value("order_id", ""));
+            if (it == orders_.end()) {
+                error = {{"code", 10004}, {"message", "order_not_found"}};
+                return nullptr;
+            }
+            return it->second;
+        }
+
+        json positions() {
+            json out = json::array();
+            for (auto& entry : positions_) {
+                out.push_back({
+                    {"instrument_name", entry.first},
+                    {"size", entry.second},
+                    {"direction", (entry.second >= 0) ? "buy" : "sell"}
+                });
+            }
+            return out;
+        }
+
+        static long long nowMs() {
+            return chrono::duration_cast<chrono::milliseconds>(
+                chrono::system_clock::now().time_since_epoch()).count();
+        }
+};
+
+// ======== mockHttpServer Class ========
+// Minimal HTTP/1.1 server with keep-alive: POST /api/v2/<method> with a JSON-RPC body
+class mockHttpServer {
+    public:
+        mockHttpServer(asio::io_context& io, mockExchange& exchange)
+            : exchange_(exchange),
+              acceptor_(io, tcp::endpoint(asio::ip::address_v4::loopback(), exchange.config().httpPort)) {
+            accept();
+        }
+
+        void stop() {
+            asio::error_code ec;
+            acceptor_.close(ec);
+        }
+
+    private:
+        struct httpConnection {
+            explicit httpConnection(tcp::socket s) : socket(move(s)), timer(socket.get_executor()) {}
+            tcp::socket socket;
+            asio::streambuf buffer;
+            asio::steady_timer timer;
+            string response;
+        };
+
+        mockExchange& exchange_;
+        tcp::acceptor acceptor_;
+
+        void accept() {
+            acceptor_.async_accept([this](const asio::error_code& ec, tcp::socket socket) {
+                if (ec) return;  // Acceptor closed
+                socket.set_option(tcp::no_delay(true));
+                readRequest(make_shared<httpConnection>(move(socket)));
+                accept();
+            });
+        }
+
+        void readRequest(shared_ptr<httpConnection> conn) {
+            asio::async_read_until(conn->socket, conn->buffer, "\r\n\r\n",
+            [this, conn](const asio::error_code& ec, size_t headerBytes) {
+                if (ec) return;  // Client closed the connection
+                string headers(asio::buffers_begin(conn->buffer.data()),
+                               asio::buffers_begin(conn->buffer.data()) + headerBytes);
+                conn->buffer.consume(headerBytes);
+                for (auto& c : headers) c = (char)tolower((unsigned char)c);
+
+                size_t length = 0;
+                size_t pos = headers.find("content-length:");
+                if (pos != string::npos) length = stoul(headers.substr(pos + 15));
+
+                auto readBody = [this, conn, length]() {
+                    size_t have = conn->buffer.size();
+                    if (have >= length) {
+                        handleBody(conn, length);
+                        return;
+                    }
+                    asio::async_read(conn->socket, conn->buffer, asio::transfer_exactly(length - have),
+                    [this, conn, length](const asio::error_code& ec, size_t) {
+                        if (!ec) handleBody(conn, length);
+                    });
+                };
+
+                // cURL waits for this before sending larger bodies
+                if (headers.find("expect: 100-continue") != string::npos) {
+                    auto interim = make_shared<string>("HTTP/1.1 100 Continue\r\n\r\n");
+                    asio::async_write(conn->socket, asio::buffer(*interim),
+                    [interim, readBody](const asio::error_code& ec, size_t) {
+                        if (!ec) readBody();
+                    });
+                } else {
+                    readBody();
+                }
+            });
+        }
+
+        void handleBody(shared_ptr<httpConnection> conn, size_t length) {
+            string body(asio::buffers_begin(conn->buffer.data()),
+                        asio::buffers_begin(conn->buffer.data()) + length);
+            conn->buffer.consume(length);
+
+            json request = json::parse(body, nullptr, false);
+            string out = request.is_discarded()
+                ? json{{"jsonrpc", "2.0"}, {"error", {{"code", -32700}, {"message", "Parse error"}}}}.dump()
+                : exchange_.handle(request).dump();
+
+            conn->response = "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nContent-Length: "
+                + to_string(out.size()) + "\r\nConnection: keep-alive\r\n\r\n" + out;
+
+            auto write = [this, conn]() {
+                asio::async_write(conn->socket, asio::buffer(conn->response),
+                [this, conn](const asio::error_code& ec, size_t) {
+                    if (!ec) readRequest(conn);
+                });
+            };
+
+            long latencyMs = exchange_.config().latencyMs;
+            if (latencyMs <= 0) {
+                write();
+                return;
+            }
+            conn->timer.expires_after(chrono::milliseconds(latencyMs));
+            conn->timer.async_wait([write](const asio::error_code& ec) {
+                if (!ec) write();
+            });
+        }
+};
+
+// ======== mockWebSocketServer Class ========
+// TLS WebSocket speaking the same JSON-RPC methods, plus public/subscribe and
+// public/unsubscribe for book.{instrument}.{interval} channels. Each channel is a
+// synthetic book that emits a snapshot on subscribe and a chained change
+// (prev_change_id -> change_id) every bookIntervalMs. With gapEvery set, every Nth change
+// refers to a change that was never sent, so subscribers have to resync.
+class mockWebSocketServer {
+    public:
+        mockWebSocketServer(asio::io_context& io, mockExchange& exchange)
+            : exchange_(exchange), tickTimer_(io), rng_(7) {
+            server_.clear_access_channels(websocketpp::log::alevel::all);
+            server_.clear_error_channels(websocketpp::log::elevel::all);
+            server_.init_asio(&io);
+            server_.set_reuse_addr(true);
+
+            auto ctx = selfSignedContext();
+            server_.set_tls_init_handler([ctx](websocketpp::connection_hdl) { return ctx; });
+            server_.set_message_handler([this](websocketpp::connection_hdl hdl, mockWsServer::message_ptr msg) {
+                on_message(hdl, msg);
+            });
+            server_.set_open_handler([this](websocketpp::connection_hdl hdl) { connections_.insert(hdl); });
+            server_.set_close_handler([this](websocketpp::connection_hdl hdl) { on_close(hdl); });
+
+            server_.listen(asio::ip::tcp::v4(), exchange.config().wsPort);
+            server_.start_accept();
+            scheduleTick();
+        }
+
+        void stop() {
+            websocketpp::lib::error_code ec;
+            server_.stop_listening(ec);
+            tickTimer_.cancel();
+            for (auto& book : books_) {
+                for (auto& hdl : book.second.subscribers) {
+                    server_.close(hdl, websocketpp::close::status::going_away, "Mock stopping", ec);
+                }
+            }
+            books_.clear();
+        }
+
+        // Closes every WebSocket connection, as a network drop would
+        void dropConnections() {
+            websocketpp::lib::error_code ec;
+            for (auto& hdl : connections_) {
+                server_.close(hdl, websocketpp::close::status::going_away, "Mock dropping connections", ec);
+            }
+        }
+
+        // Book snapshots sent, including those answering a resubscribe
+        size_t snapshots() const {
+            return snapshots_.load(memory_order_relaxed);
+        }
+
+        // Changes sent out of chain because of gapEvery
+        size_t gaps() const {
+            return gaps_.load(memory_order_relaxed);
+        }
+
+        // change_ids of the snapshots that followed a gap on their channel, in the order sent
+        vector<long long> resyncChangeIds() const {
+            lock_guard<mutex> lock(resyncMutex_);
+            return resyncChangeIds_;
+        }
+
+    private:
+        using hdlSet = set<websocketpp::connection_hdl, owner_less<websocketpp::connection_hdl>>;
+
+        struct mockBook {
+            string instrument;
+            long long changeId = 1;
+            size_t changes = 0;
+            bool gapped = false;                 // A change was skipped since the last snapshot
+            vector<pair<double, double>> bids;   // Best first
+            vector<pair<double, double>> asks;
+            hdlSet subscribers;
+        };
+
+        mockExchange& exchange_;
+        mockWsServer server_;
+        asio::steady_timer tickTimer_;
+        mt19937 rng_;
+        map<string, mockBook> books_;   // <Channel, Book>; only touched on the io thread
+        hdlSet connections_;            // Open connections; only touched on the io thread
+        atomic<size_t> snapshots_{0};
+        atomic<size_t> gaps_{0};
+        mutable mutex resyncMutex_;     // Protects resyncChangeIds_
+        vector<long long> resyncChangeIds_;
+
+        // ------ Request Handling ------
+        void on_message(websocketpp::connection_hdl hdl, mockWsServer::message_ptr msg) {
+            json request = json::parse(msg->get_payload(), nullptr, false);
+            if (request.is_discarded()) return;
+
+            string method = request.value("method", "");
+            json response;
+            if (method == "public/subscribe" || method == "private/subscribe") {
+                json channels = json::array();
+                for (auto& channel : request["params"].value("channels", json::array())) {
+                    subscribe(hdl, channel.get<string>());
+                    channels.push_back(channel);
+                }
+                response = {{"jsonrpc", "2.0"}, {"id", request.value("id", json())}, {"result", channels}};
+            } else if (method == "public/unsubscribe" || method == "private/unsubscribe") {
+                json channels = json::array();
+                for (auto& channel : request["params"].value("channels", json::array())) {
+                    auto it = books_.find(channel.get<string>());
+                    if (it != books_.end()) {
+                        it->second.subscribers.erase(hdl);
+                        if (it->second.subscribers.empty()) books_.erase(it);
+                    }
+                    channels.push_back(channel);
+                }
+                response = {{"jsonrpc", "2.0"}, {"id", request.value("id", json())}, {"result", channels}};
+            } else {
+                response = exchange_.handle(request);
+            }
+            respond(hdl, response.dump());
+        }
+
+        // Books nobody watches are dropped, so a long soak does not grow the mock
+        void on_close(websocketpp::connection_hdl hdl) {
+            connections_.erase(hdl);
+            for (auto it = books_.begin(); it != books_.end();) {
+                it->second.subscribers.erase(hdl);
+                if (it->second.subscribers.empty()) it = books_.erase(it);
+                else ++it;
+            }
+        }
+
+        void respond(websocketpp::connection_hdl hdl, const string& payload) {
+            long latencyMs = exchange_.config().latencyMs;
+            if (latencyMs <= 0) {
+                send(hdl, payload);
+                return;
+            }
+            server_.set_timer(latencyMs, [this, hdl, payload](const websocketpp::lib::error_code& ec) {
+                if (!ec) send(hdl, payload);
+            });
+        }
+
+        void send(websocketpp::connection_hdl hdl, const string& payload) {
+            websocketpp::lib::error_code ec;
+            server_.send(hdl, payload, websocketpp::frame::opcode::text, ec);
+        }
+
+        // ------ Book Channels ------
+        void subscribe(websocketpp::connection_hdl hdl, const string& channel) {
+            if (channel.rfind("book.", 0) != 0) return;
+            mockBook& book = books_[channel];
+            if (book.bids.empty()) {
+                size_t second = channel.find('.', 5);
+                book.instrument = channel.substr(5, second == string::npos ? string::npos : second - 5);
+                for (size_t i = 0; i < exchange_.config().bookDepth; ++i) {
+                    book.bids.push_back({50000.0 - 0.5 * (i + 1), 100.0});
+                    book.asks.push_back({50000.0 + 0.5 * (i + 1), 100.0});
+                }
+            }
+            book.subscribers.insert(hdl);
+
+            json bids = json::array();
+            json asks = json::array();
+            for (auto& level : book.bids) bids.push_back({"new", level.first, level.second});
+            for (auto& level : book.asks) asks.push_back({"new", level.first, level.second});
+            json snapshot = notification(channel, {
+                {"type", "snapshot"},
+                {"timestamp", nowMs()},
+                {"change_id", book.changeId},
+                {"instrument_name", book.instrument},
+                {"bids", bids},
+                {"asks", asks}
+            });
+            send(hdl, snapshot.dump());
+            snapshots_.fetch_add(1, memory_order_relaxed);
+            if (book.gapped) {
+                book.gapped = false;
+                lock_guard<mutex> lock(resyncMutex_);
+                resyncChangeIds_.push_back(book.changeId);
+            }
+        }
+
+        void scheduleTick() {
+            tickTimer_.expires_after(chrono::milliseconds(exchange_.config().bookIntervalMs));
+            tickTimer_.async_wait([this](const asio::error_code& ec) {
+                if (ec) return;
+                for (auto& entry : books_) {
+                    if (!entry.second.subscribers.empty()) publishChange(entry.first, entry.second);
+                }
+                scheduleTick();
+            });
+        }
+
+        void publishChange(const string& channel, mockBook& book) {
+            uniform_int_distribution<size_t> levelDist(0, book.bids.size() - 1);
+            uniform_real_distribution<double> amountDist(1, 500);
+            json bids = json::array();
+            json asks = json::array();
+            for (size_t i = 0; i < exchange_.config().levelsPerChange; ++i) {
+                auto& side = (i % 2 == 0) ? book.bids : book.asks;
+                auto& level = side[levelDist(rng_)];
+                level.second = amountDist(rng_);
+                ((i % 2 == 0) ? bids : asks).push_back({"change", level.first, level.second});
+            }
+
+            long long prev = book.changeId++;
+            size_t gapEvery = exchange_.config().gapEvery;
+            if (gapEvery && ++book.changes % gapEvery == 0) {
+                prev = book.changeId++;   // The change before this one is never sent
+                book.gapped = true;
+                gaps_.fetch_add(1, memory_order_relaxed);
+            }
+            string payload = notification(channel, {
+                {"type", "change"},
+                {"timestamp", nowMs()},
+                {"prev_change_id", prev},
+                {"change_id", book.changeId},
+                {"instrument_name", book.instrument},
+                {"bids", bids},
+                {"asks", asks}
+            }).dump();
+            for (auto& hdl : book.subscribers) send(hdl, payload);
+        }
+
+        static json notification(const string& channel, const json& data) {
+            return {
+                {"jsonrpc", "2.0"},
+                {"method", "subscription"},
+                {"params", {{"channel", channel}, {"data", data}}}
+            };
+        }
+
+        static long long nowMs() {
+            return chrono::duration_cast<chrono::milliseconds>(
+                chrono::system_clock::now().time_since_epoch()).count();
+        }
+
+        // Throwaway RSA key and certificate so the mock can speak wss:// like Deribit
+        static shared_ptr<asio::ssl::context> selfSignedContext() {
+            EVP_PKEY* key = nullptr;
+            EVP_PKEY_CTX* keyCtx = EVP_PKEY_CTX_new_id(EVP_PKEY_RSA, nullptr);
+            EVP_PKEY_keygen_init(keyCtx);
+            EVP_PKEY_CTX_set_rsa_keygen_bits(keyCtx, 2048);
+            EVP_PKEY_keygen(keyCtx, &key);
+            EVP_PKEY_CTX_free(keyCtx);
+
+            X509* cert = X509_new();
+            ASN1_INTEGER_set(X509_get_serialNumber(cert), 1);
+            X509_gmtime_adj(X509_getm_notBefore(cert), 0);
+            X509_gmtime_adj(X509_getm_notAfter(cert), 24 * 3600);
+            X509_set_pubkey(cert, key);
+            X509_NAME* name = X509_get_subject_name(cert);
+            X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC, (const unsigned char*)"localhost", -1, -1, 0);
+            X509_set_issuer_name(cert, name);
+            X509_sign(cert, key, EVP_sha256());
+
+            auto ctx = make_shared<asio::ssl::context>(asio::ssl::context::sslv23);
+            ctx->set_options(asio::ssl::context::default_workarounds | asio::ssl::context::no_sslv2);
+            SSL_CTX_use_certificate(ctx->native_handle(), cert);
+            SSL_CTX_use_PrivateKey(ctx->native_handle(), key);
+            X509_free(cert);
+            EVP_PKEY_free(key);
+            return ctx;
+        }
+};
+
+// ======== mockDeribit Class ========
+// Owns the mock exchange and both front ends on one background event loop
+class mockDeribit {
+    public:
+        explicit mockDeribit(const mockConfig& config = mockConfig())
+            : exchange_(config), work_(asio::make_work_guard(io_)), http_(io_, exchange_), ws_(io_, exchange_) {
+            thread_ = thread([this] { io_.run(); });
+        }
+
+        ~mockDeribit() {
+            // Close listeners and sessions on the io thread, then end the loop
+            promise<void> stopped;
+            asio::post(io_, [this, &stopped] {
+                http_.stop();
+                ws_.stop();
+                stopped.set_value();
+            });
+            stopped.get_future().wait();
+            work_.reset();
+            io_.stop();
+            if (thread_.joinable()) thread_.join();
+        }
+
+        size_t rejected() {
+            return exchange_.rejected();
+        }
+
+        size_t snapshots() const {
+            return ws_.snapshots();
+        }
+
+        void refuseAuth(bool refuse) {
+            exchange_.refuseAuth(refuse);
+        }
+
+        // Closes every WebSocket session to the mock; they are free to reconnect
+        void dropConnections() {
+            promise<void> dropped;
+            asio::post(io_, [this, &dropped] {
+                ws_.dropConnections();
+                dropped.set_value();
+            });
+            dropped.get_future().wait();
+        }
+
+        size_t gaps() const {
+            return ws_.gaps();
+        }
+
+        vector<long long> resyncChangeIds() const {
+            return ws_.resyncChangeIds();
+        }
+
+        // Settings that point tradeManager and orderBookServer at this mock
+        unordered_map<string, string> env() const {
+            const mockConfig& config = exchange_.config();
+            return {
+                {"DERIBIT_API_URL", "http://127.0.0.1:" + to_string(config.httpPort) + "/api/v2/"},
+                {"DERIBIT_WS_URL", "wss://127.0.0.1:" + to_string(config.wsPort) + "/ws/api/v2"},
+                {"DERIBIT_CLIENT_ID", "mock-client"},
+                {"DERIBIT_CLIENT_SECRET", "mock-secret"},
+                {"STATS_DUMP_INTERVAL_S", "0"}
+            };
+        }
+
+    private:
+        asio::io_context io_;
+        mockExchange exchange_;
+        asio::executor_work_guard<asio::io_context::executor_type> work_;
+        mockHttpServer http_;
+        mockWebSocketServer ws_;
+        thread thread_;
+};
@@ -0,0 +1,96 @@
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <random>
+#include <chrono>
+#include "../include/orderBook.h"
+
+using namespace std;
+using namespace std::chrono;
+
+// Benchmark settings
+const size_t UPDATES_PER_RUN = 2000000;   // Level updates timed per depth
+const size_t SNAPSHOTS_PER_RUN = 200000;  // Top-N extractions timed per depth
+const double TICK = 0.5;                  // Price increment between levels
+const double MID = 50000;                 // Centre of the synthetic book
+
+struct levelUpdate {
+    bookSide side;
+    double price;
+    double amount;
+};
+
+// Random changes, inserts and deletes confined to `depth` levels around the mid,
+// generated up front so only the book is on the timed path
+vector<levelUpdate> makeUpdates(size_t depth, size_t count) {
+    mt19937_64 rng(42);
+    uniform_int_distribution<size_t> levelDist(1, depth);
+    uniform_int_distribution<int> sideDist(0, 1);
+    uniform_real_distribution<double> amountDist(1, 1000);
+    bernoulli_distribution deleteDist(0.2);
+
+    vector<levelUpdate> updates(count);
+    for (auto& update : updates) {
+        update.side = sideDist(rng) ? bookSide::bid : bookSide::ask;
+        double offset = levelDist(rng) * TICK;
+        update.price = (update.side == bookSide::bid) ? MID - offset : MID + offset;
+        update.amount = deleteDist(rng) ? 0 : amountDist(rng);
+    }
+    return updates;
+}
+
+void fill(orderBook& book, size_t depth) {
+    for (size_t i = 1; i <= depth; ++i) {
+        book.update(bookSide::bid, MID - i * TICK, 100);
+        book.update(bookSide::ask, MID + i * TICK, 100);
+    }
+}
+
+int main() {
+    cout << left << setw(8) << "depth"
+         << setw(16) << "update_ns"
+         << setw(16) << "updates/s"
+         << setw(16) << "snapshot_ns"
+         << setw(16) << "best_ns" << endl;
+
+    for (size_t depth : {10, 100, 1000}) {
+        orderBook book(depth * 2);
+        fill(book, depth);
+        vector<levelUpdate> updates = makeUpdates(depth, UPDATES_PER_RUN);
+
+        // Level updates
+        auto start = steady_clock::now();
+        for (const auto& update : updates) {
+            book.update(update.side, update.price, update.amount);
+        }
+        double updateNs = duration<double, nano>(steady_clock::now() - start).count() / UPDATES_PER_RUN;
+
+        // Top-N snapshot of both sides into a preallocated buffer
+        fill(book, depth);
+        vector<bookLevel> buffer(depth);
+        double checksum = 0;
+        start = steady_clock::now();
+        for (size_t i = 0; i < SNAPSHOTS_PER_RUN; ++i) {
+            size_t count = book.snapshot(bookSide::bid, buffer.data(), depth);
+            count += book.snapshot(bookSide::ask, buffer.data(), depth);
+            checksum += buffer[count % depth].amount;
+        }
+        double snapshotNs = duration<double, nano>(steady_clock::now() - start).count() / SNAPSHOTS_PER_RUN;
+
+        // Lock-free best bid/ask read
+        start = steady_clock::now();
+        for (size_t i = 0; i < SNAPSHOTS_PER_RUN; ++i) {
+            checksum += book.best().bidPrice;
+        }
+        double bestNs = duration<double, nano>(steady_clock::now() - start).count() / SNAPSHOTS_PER_RUN;
+
+        cout << left << setw(8) << depth
+             << setw(16) << fixed << setprecision(1) << updateNs
+             << setw(16) << setprecision(0) << (1e9 / updateNs)
+             << setw(16) << setprecision(1) << snapshotNs
+             << setw(16) << bestNs << endl;
+
+        if (checksum < 0) cout << checksum << endl;  // Keep the reads observable
+    }
+    return 0;
+}
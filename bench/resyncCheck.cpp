@@ -0,0 +1,152 @@
+#include <iostream>
+#include <string>
+#include <cstring>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <set>
+#include <algorithm>
+#include "../include/webServer.h"
+#include "mockDeribit.h"
+
+using namespace std;
+using namespace std::chrono;
+using json = nlohmann::json;
+
+// Checks that the server recovers from a broken change_id chain: the mock drops a change every
+// --gap-every changes, and a binary client must see the server resync (a resubscribe answered
+// with a new snapshot), receive that book as a fresh snapshot frame, carrying the change_id of
+// a snapshot the mock sent after a gap, and never get a delta that does not apply on top of the
+// frame before it. Exits non-zero otherwise, so it can run as a test.
+
+using downstreamClient = websocketpp::client<websocketpp::config::asio_client>;
+
+const string INSTRUMENT = "BTC-PERPETUAL";
+const uint16_t FIRST_PORT = 19310;        // Clear of the ports taken by bench and schedulerCheck
+
+struct checkConfig {
+    size_t gapEvery = 50;                 // Mock changes between lost ones
+    long bookIntervalMs = 5;              // Mock change rate
+    double seconds = 2;                   // How long the client listens
+};
+
+int main(int argc, char** argv) {
+    checkConfig config;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        string flag = argv[i];
+        string value = argv[i + 1];
+        if (flag == "--gap-every") config.gapEvery = stoul(value);
+        else if (flag == "--book-interval-ms") config.bookIntervalMs = stol(value);
+        else if (flag == "--seconds") config.seconds = stod(value);
+        else {
+            cerr << "Unknown option: " << flag << endl;
+            return 1;
+        }
+    }
+
+    mockConfig upstream;
+    upstream.httpPort = FIRST_PORT;
+    upstream.wsPort = FIRST_PORT + 1;
+    upstream.bookIntervalMs = config.bookIntervalMs;
+    upstream.gapEvery = config.gapEvery;
+    mockDeribit mock(upstream);
+
+    orderBookServer server(mock.env());
+    uint16_t port = FIRST_PORT + 2;
+    server.listen(port);
+    thread serverThread([&server] { server.run(); });
+
+    // Frames seen by the client; only its io thread writes them
+    atomic<size_t> snapshots{0}, deltas{0}, broken{0};
+    atomic<size_t> resumed{0};            // Deltas after the first resync snapshot
+    uint64_t lastSequence = 0;
+    bool resynced = false;                // A snapshot frame matched a resync snapshot of the mock
+    set<uint64_t> snapshotSequences;      // change_ids of the snapshot frames
+
+    downstreamClient client;
+    client.clear_access_channels(websocketpp::log::alevel::all);
+    client.clear_error_channels(websocketpp::log::elevel::all);
+    client.init_asio();
+    client.start_perpetual();
+    client.set_open_handler([&client](websocketpp::connection_hdl hdl) {
+        string subscribe = json{{"method", "subscribe"}, {"symbol", INSTRUMENT}, {"depth", 5}, {"interval", "raw"}}.dump();
+        websocketpp::lib::error_code ec;
+        client.send(hdl, subscribe, websocketpp::frame::opcode::text, ec);
+    });
+    client.set_message_handler([&](websocketpp::connection_hdl, downstreamClient::message_ptr msg) {
+        if (msg->get_opcode() != websocketpp::frame::opcode::binary) return;   // Subscribe reply
+        const string& payload = msg->get_payload();
+        if (payload.size() < sizeof(bookFrameHeader)) return;
+        bookFrameHeader header;
+        memcpy(&header, payload.data(), sizeof(header));
+        if (header.type == (uint8_t)bookFrameType::snapshot) {
+            ++snapshots;
+            snapshotSequences.insert(header.sequence);
+            if (!resynced) {
+                vector<long long> ids = mock.resyncChangeIds();
+                resynced = find(ids.begin(), ids.end(), (long long)header.sequence) != ids.end();
+            }
+        } else if (header.type == (uint8_t)bookFrameType::delta) {
+            ++deltas;
+            if (resynced) ++resumed;
+            if (snapshots == 0 || header.prevSequence != lastSequence) ++broken;
+        }
+        lastSequence = header.sequence;
+    });
+
+    websocketpp::lib::error_code ec;
+    auto con = client.get_connection("ws://127.0.0.1:" + to_string(port), ec);
+    if (ec) {
+        cerr << "FAIL: " << ec.message() << endl;
+        server.stop();
+        serverThread.join();
+        return 1;
+    }
+    con->add_subprotocol(BOOK_FRAME_PROTOCOL);
+    client.connect(con);
+    thread clientThread([&client] { client.run(); });
+
+    this_thread::sleep_for(duration<double>(config.seconds));
+    size_t gaps = mock.gaps();
+    size_t sent = mock.snapshots();
+    vector<long long> resyncIds = mock.resyncChangeIds();
+
+    client.stop_perpetual();
+    client.stop();
+    server.stop();
+    clientThread.join();
+    serverThread.join();
+
+    // Conflation can also turn a delta into a snapshot frame; only a resync reproduces the
+    // change_id of a snapshot the mock sent after a gap
+    size_t resyncFrames = 0;
+    for (long long id : resyncIds) resyncFrames += snapshotSequences.count((uint64_t)id);
+
+    cout << "gaps=" << gaps << " upstream_snapshots=" << sent << " upstream_resyncs=" << resyncIds.size()
+         << " client_snapshots=" << snapshots.load() << " client_resync_snapshots=" << resyncFrames
+         << " client_deltas=" << deltas.load() << " resumed_deltas=" << resumed.load()
+         << " broken_deltas=" << broken.load() << endl;
+
+    int status = 0;
+    if (gaps == 0) {
+        cerr << "FAIL: the mock never skipped a change_id" << endl;
+        status = 1;
+    }
+    if (resyncIds.empty()) {
+        cerr << "FAIL: the server never resubscribed for a new snapshot after a gap" << endl;
+        status = 1;
+    }
+    if (resyncFrames == 0) {
+        cerr << "FAIL: the client got no fresh snapshot frame after a resync" << endl;
+        status = 1;
+    }
+    if (broken > 0) {
+        cerr << "FAIL: " << broken.load() << " deltas did not apply on the previous frame" << endl;
+        status = 1;
+    }
+    if (resumed == 0) {
+        cerr << "FAIL: no deltas were published after the book resynced" << endl;
+        status = 1;
+    }
+    return status;
+}
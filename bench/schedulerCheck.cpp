@@ -0,0 +1,101 @@
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <cmath>
+#include <chrono>
+#include <atomic>
+#include <future>
+#include "../include/deribitApi.h"
+#include "../include/orderScheduler.h"
+#include "mockDeribit.h"
+
+using namespace std;
+using namespace std::chrono;
+
+// Checks that orderScheduler keeps a stream of orders inside the exchange's matching-engine
+// limit: run against a rate-limited mock, the paced run must draw no too_many_requests (10028)
+// and, past the burst, must sustain the configured rate. Exits non-zero otherwise, so it can
+// run as a test.
+
+const string INSTRUMENT = "BTC-PERPETUAL";
+const uint16_t FIRST_PORT = 19300;        // Clear of the ports taken by bench
+const double RATE_TOLERANCE = 0.15;       // Allowed deviation of the sustained rate, as a fraction
+
+struct checkConfig {
+    double rateLimit = 100;               // Mock matching-engine requests per second
+    double rateBurst = 20;                // Mock matching-engine burst
+    double seconds = 2;                   // Length of the paced run past the burst
+    long latencyMs = 0;                   // Simulated exchange latency
+};
+
+int main(int argc, char** argv) {
+    checkConfig config;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        string flag = argv[i];
+        string value = argv[i + 1];
+        if (flag == "--rate-limit") config.rateLimit = stod(value);
+        else if (flag == "--rate-burst") config.rateBurst = stod(value);
+        else if (flag == "--seconds") config.seconds = stod(value);
+        else if (flag == "--latency-ms") config.latencyMs = stol(value);
+        else {
+            cerr << "Unknown option: " << flag << endl;
+            return 1;
+        }
+    }
+
+    mockConfig limited;
+    limited.httpPort = FIRST_PORT;
+    limited.wsPort = FIRST_PORT + 1;
+    limited.latencyMs = config.latencyMs;
+    limited.matchingRate = config.rateLimit;
+    limited.matchingBurst = config.rateBurst;
+    mockDeribit mock(limited);
+    tradeManager trader(mock.env());
+
+    // Opens the WebSocket outside the measured window
+    promise<void> ready;
+    trader.submitAsync(tradeOp::orderBook(INSTRUMENT, 1), [&ready](const string&) { ready.set_value(); });
+    ready.get_future().wait();
+
+    size_t burst = (size_t)config.rateBurst;
+    size_t count = burst + (size_t)(config.rateLimit * config.seconds);
+    atomic<size_t> failed{0};
+
+    schedulerConfig limits;
+    limits.matching = {config.rateBurst, config.rateLimit, 1};
+    orderScheduler scheduler(trader, limits);
+    auto start = steady_clock::now();
+    for (size_t i = 0; i < count; ++i) {
+        scheduler.submit(tradeOp::order(i % 2, INSTRUMENT, 10, "market"), [&failed](const string& response) {
+            if (response.find("\"error\"") != string::npos) failed.fetch_add(1, memory_order_relaxed);
+        });
+    }
+    scheduler.drain();
+    double elapsedS = duration<double>(steady_clock::now() - start).count();
+
+    // The burst goes out at once; everything after it is paced by the refill rate
+    double sustained = (count - burst) / max(elapsedS, 1e-9);
+    size_t rejected = mock.rejected();
+    bool rateOk = fabs(sustained - config.rateLimit) <= config.rateLimit * RATE_TOLERANCE;
+
+    cout << fixed << setprecision(1)
+         << "orders=" << count << " seconds=" << elapsedS << " sustained_per_sec=" << sustained
+         << " limit_per_sec=" << config.rateLimit << " too_many_requests=" << rejected
+         << " failed=" << failed.load() << endl;
+
+    int status = 0;
+    if (rejected > 0) {
+        cerr << "FAIL: the paced run drew " << rejected << " too_many_requests rejections" << endl;
+        status = 1;
+    }
+    if (failed.load() > 0) {
+        cerr << "FAIL: " << failed.load() << " orders were answered with an error" << endl;
+        status = 1;
+    }
+    if (!rateOk) {
+        cerr << "FAIL: sustained " << sustained << " orders/s against a " << config.rateLimit
+             << "/s limit (tolerance " << (RATE_TOLERANCE * 100) << "%)" << endl;
+        status = 1;
+    }
+    return status;
+}
@@ -0,0 +1,486 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+#include <deque>
+#include <map>
+#include <unordered_map>
+#include <unordered_set>
+#include <shared_mutex>
+#include <mutex>
+#include <atomic>
+#include <functional>
+#include "deribitSession.h"
+#include "wireCodec.h"
+
+using namespace std;
+
+const size_t MAX_CLOSED_ORDERS = 10000;      // Filled/cancelled orders kept for status lookups
+const size_t MAX_CACHED_FILLS = 10000;       // Most recent own trades kept
+const long RESYNC_RETRY_MS = 500;            // First wait before repeating a failed resync
+const long RESYNC_RETRY_MAX_MS = 30000;      // The wait doubles after each failure up to this
+
+// Private channels the cache follows. user.changes carries position updates, which
+// user.portfolio (account totals per currency) does not.
+const string ORDERS_CHANNEL = "user.orders.any.any.raw";
+const string TRADES_CHANNEL = "user.trades.any.any.raw";
+const string CHANGES_CHANNEL = "user.changes.any.any.raw";
+const string PORTFOLIO_CHANNEL = "user.portfolio.any";
+
+// Latest known state of one order, with the raw Deribit order object
+struct orderRecord {
+    string orderId;
+    string instrument;
+    string direction;          // "buy" / "sell"
+    string state;              // "open", "filled", "cancelled", "untriggered", ...
+    string label;
+    double price = 0;
+    double amount = 0;
+    double filledAmount = 0;
+    long long updated = 0;     // last_update_timestamp, ms
+    string raw;
+    long long notifiedIn = 0;  // Resync generation current when a notification last wrote it
+    bool pending = false;      // Changed locally by a cancel or edit the exchange has not confirmed yet
+
+    bool isOpen() const { return state == "open" || state == "untriggered"; }
+};
+
+// Latest known position in one instrument, with the raw Deribit position object
+struct positionRecord {
+    string instrument;
+    double size = 0;           // Signed; negative when short
+    double averagePrice = 0;
+    string raw;
+    long long notifiedIn = 0;  // Resync generation current when a notification last wrote it
+};
+
+// One of our own trades
+struct fillRecord {
+    string tradeId;
+    string orderId;
+    string instrument;
+    string direction;
+    double price = 0;
+    double amount = 0;
+    string raw;
+};
+
+// ======== accountState Class ========
+// In-process copy of the account's orders, fills, positions and portfolio, so status
+// checks are answered from memory instead of a REST round trip. Notifications from the
+// private user channels are applied on the session thread. Every time the session opens
+// (including after a reconnect) the open orders and positions are re-read with
+// private/get_open_orders and private/get_positions on the same connection, so nothing
+// missed while disconnected survives; a resync that fails is repeated with backoff. A resync
+// never overwrites, and never drops, an entry a notification wrote after the request went out. While the session is closed the cache
+// is not ready, so cached queries go to REST until the next resync completes. Readers take
+// a shared lock and copy what they need.
+class accountState {
+    public:
+        using positionListener = function<void(const string&, double)>;   // (Instrument, signed size)
+        using orderListener = function<void(const orderRecord&)>;
+        explicit accountState(deribitSession& session) : session_(session) {
+            session_.subscribe(ORDERS_CHANNEL, [this](string_view data) { onOrders(data); });
+            session_.subscribe(TRADES_CHANNEL, [this](string_view data) { onTrades(data); });
+            session_.subscribe(CHANGES_CHANNEL, [this](string_view data) { onChanges(data); });
+            session_.subscribe(PORTFOLIO_CHANNEL, [this](string_view data) { onPortfolio(data); });
+            session_.set_close_handler([this] { ready_.store(false, memory_order_release); });
+            session_.set_ready_handler([this] { resync(); });
+        }
+
+        accountState(const accountState&) = delete;
+        accountState& operator=(const accountState&) = delete;
+
+        // True once open orders and positions have been loaded on the current connection
+        bool ready() const {
+            return ready_.load(memory_order_acquire);
+        }
+
+        // Called with every position change, on the session thread and under the cache's write
+        // lock, so it must not call back into the cache. Positions already known are reported
+        // right away.
+        void setPositionListener(positionListener listener) {
+            unique_lock<shared_mutex> lock(mutex_);
+            positionListener_ = move(listener);
+            if (!positionListener_) return;
+            for (auto& entry : positions_) positionListener_(entry.first, entry.second.size);
+        }
+
+        // Called with every order change the exchange reports, like the position listener.
+        // An open order that a resync found closed is reported once with the state "closed".
+        void setOrderListener(orderListener listener) {
+            unique_lock<shared_mutex> lock(mutex_);
+            orderListener_ = move(listener);
+            if (!orderListener_) return;
+            for (auto& entry : orders_) orderListener_(entry.second);
+        }
+
+        // ------ Structured Queries ------
+        bool order(const string& orderId, orderRecord& out) const {
+            shared_lock<shared_mutex> lock(mutex_);
+            auto it = orders_.find(orderId);
+            if (it == orders_.end()) return false;
+            out = it->second;
+            return true;
+        }
+
+        vector<orderRecord> openOrders() const {
+            vector<orderRecord> out;
+            shared_lock<shared_mutex> lock(mutex_);
+            for (auto& entry : orders_) {
+                if (entry.second.isOpen()) out.push_back(entry.second);
+            }
+            return out;
+        }
+
+        // Signed position size, 0 when flat or unknown
+        double position(const string& instrument) const {
+            shared_lock<shared_mutex> lock(mutex_);
+            auto it = positions_.find(instrument);
+            return (it != positions_.end()) ? it->second.size : 0;
+        }
+
+        vector<fillRecord> fills(const string& orderId) const {
+            vector<fillRecord> out;
+            shared_lock<shared_mutex> lock(mutex_);
+            for (auto& fill : fills_) {
+                if (fill.orderId == orderId) out.push_back(fill);
+            }
+            return out;
+        }
+
+        // ------ JSON-RPC Shaped Responses ------
+        // Same shape as the REST responses, so cached and live modes are interchangeable
+
+        // private/get_positions
+        string positionsResponse() const {
+            string out = R"({"jsonrpc":"2.0","result":[)";
+            shared_lock<shared_mutex> lock(mutex_);
+            bool first = true;
+            for (auto& entry : positions_) {
+                if (!first) out.push_back(',');
+                out.append(entry.second.raw);
+                first = false;
+            }
+            out.append("]}");
+            return out;
+        }
+
+        // private/get_open_orders
+        string openOrdersResponse() const {
+            string out = R"({"jsonrpc":"2.0","result":[)";
+            shared_lock<shared_mutex> lock(mutex_);
+            bool first = true;
+            for (auto& entry : orders_) {
+                if (!entry.second.isOpen()) continue;
+                if (!first) out.push_back(',');
+                out.append(entry.second.raw);
+                first = false;
+            }
+            out.append("]}");
+            return out;
+        }
+
+        // private/get_order_state; empty for an order the cache has not seen (e.g. one that
+        // closed before the cache started) or has a change pending for, which the caller must
+        // look up remotely
+        string orderStateResponse(const string& orderId) const {
+            shared_lock<shared_mutex> lock(mutex_);
+            auto it = orders_.find(orderId);
+            if (it == orders_.end() || it->second.pending) return "";
+            return R"({"jsonrpc":"2.0","result":)" + it->second.raw + "}";
+        }
+
+        // Latest user.portfolio notification for `currency` (e.g. "BTC"), empty if none yet
+        string portfolio(const string& currency) const {
+            shared_lock<shared_mutex> lock(mutex_);
+            auto it = portfolio_.find(currency);
+            return (it != portfolio_.end()) ? it->second : "";
+        }
+
+        // ------ Optimistic Updates ------
+        // Applied when a cancel or edit is sent, so openOrders() reflects it a round trip early.
+        // The order's notification confirms or replaces the change. A request that failed is
+        // undone with restore() and followed by refresh(). `before`, when given, receives each
+        // marked order as it was.
+
+        // Marks every open order `matches(record)` accepts as cancelled; returns how many
+        template <typename Predicate>
+        size_t markCancelled(Predicate matches, vector<orderRecord>* before = nullptr) {
+            unique_lock<shared_mutex> lock(mutex_);
+            size_t count = 0;
+            for (auto& entry : orders_) {
+                orderRecord& record = entry.second;
+                if (!record.isOpen() || !matches(record)) continue;
+                if (before) before->push_back(record);
+                record.state = "cancelled";
+                record.pending = true;
+                closed_.push_back(record.orderId);
+                ++count;
+            }
+            trimClosedLocked();
+            return count;
+        }
+
+        void markAmended(const string& orderId, double amount, double price, vector<orderRecord>* before = nullptr) {
+            unique_lock<shared_mutex> lock(mutex_);
+            auto it = orders_.find(orderId);
+            if (it == orders_.end() || !it->second.isOpen()) return;
+            if (before) before->push_back(it->second);
+            it->second.amount = amount;
+            if (price > 0) it->second.price = price;
+            it->second.pending = true;
+        }
+
+        // Puts back orders as markCancelled/markAmended found them, unless a notification or
+        // resync has replaced the local change since
+        void restore(const vector<orderRecord>& before) {
+            if (before.empty()) return;
+            unique_lock<shared_mutex> lock(mutex_);
+            for (auto& saved : before) {
+                auto it = orders_.find(saved.orderId);
+                if (it != orders_.end() && it->second.pending) it->second = saved;
+            }
+        }
+
+        // Re-reads open orders and positions on the session, as after a reconnect
+        void refresh() {
+            resync();
+        }
+
+    private:
+        deribitSession& session_;
+        atomic<bool> ready_{false};
+
+        mutable shared_mutex mutex_;                        // Protects everything below
+        unordered_map<string, orderRecord> orders_;         // <Order id, Order>
+        deque<string> closed_;                              // Closed order ids, oldest first
+        map<string, positionRecord> positions_;             // <Instrument, Position>
+        deque<fillRecord> fills_;                           // Newest at the back
+        unordered_map<string, string> portfolio_;           // <Currency, Raw portfolio>
+        long long generation_ = 0;                          // Incremented by every resync
+        long retryDelayMs_ = RESYNC_RETRY_MS;               // Wait before repeating the next failed resync
+        positionListener positionListener_;
+        orderListener orderListener_;
+
+        // ------ Resync ------
+        // Runs on the session thread once the session is open; both requests go out after
+        // the channel subscriptions on the same connection
+        void resync() {
+            long long generation;
+            {
+                unique_lock<shared_mutex> lock(mutex_);
+                generation = ++generation_;
+            }
+            auto pending = make_shared<atomic<int>>(2);
+            auto done = [this, pending] {
+                if (--*pending > 0) return;
+                {
+                    unique_lock<shared_mutex> lock(mutex_);
+                    retryDelayMs_ = RESYNC_RETRY_MS;
+                }
+                ready_.store(true, memory_order_release);
+            };
+
+            session_.request("private/get_open_orders", "{}", [this, done, generation](string_view response) {
+                static const jsonScanner fields{"result"};
+                jsonValue result;
+                fields.scan(response, &result);
+                if (!result.found()) {
+                    cerr << "Open orders resync failed: " << response << endl;
+                    retry(generation);
+                    return;
+                }
+                unique_lock<shared_mutex> lock(mutex_);
+                unordered_set<string> listed;
+                forEachElement(result.raw, [&](const jsonValue& order) {
+                    string id = applyOrderLocked(order.raw, generation);
+                    if (!id.empty()) listed.insert(id);
+                });
+                // Orders that closed while we were not listening
+                for (auto it = orders_.begin(); it != orders_.end();) {
+                    bool stale = it->second.isOpen() && !listed.count(it->first) && it->second.notifiedIn < generation;
+                    if (stale && orderListener_) {
+                        it->second.state = "closed";
+                        orderListener_(it->second);
+                    }
+                    it = stale ? orders_.erase(it) : next(it);
+                }
+                lock.unlock();
+                done();
+            });
+            session_.request("private/get_positions", "{}", [this, done, generation](string_view response) {
+                static const jsonScanner fields{"result"};
+                jsonValue result;
+                fields.scan(response, &result);
+                if (!result.found()) {
+                    cerr << "Positions resync failed: " << response << endl;
+                    retry(generation);
+                    return;
+                }
+                unique_lock<shared_mutex> lock(mutex_);
+                unordered_set<string> listed;
+                forEachElement(result.raw, [&](const jsonValue& position) {
+                    string instrument = applyPositionLocked(position.raw, generation);
+                    if (!instrument.empty()) listed.insert(instrument);
+                });
+                // Positions closed while we were not listening are reported flat and dropped
+                for (auto it = positions_.begin(); it != positions_.end();) {
+                    bool stale = !listed.count(it->first) && it->second.notifiedIn < generation;
+                    if (stale && positionListener_) positionListener_(it->first, 0);
+                    it = stale ? positions_.erase(it) : next(it);
+                }
+                lock.unlock();
+                done();
+            });
+        }
+
+        // Repeats a failed resync after the backoff, unless a newer one (after a reconnect, or
+        // the other request of the same resync failing too) has started since
+        void retry(long long generation) {
+            long delayMs;
+            long long claimed;
+            {
+                unique_lock<shared_mutex> lock(mutex_);
+                if (generation != generation_) return;
+                delayMs = retryDelayMs_;
+                retryDelayMs_ = min(RESYNC_RETRY_MAX_MS, retryDelayMs_ * 2);
+                claimed = ++generation_;   // So the other request failing too does not schedule another
+            }
+            session_.schedule(delayMs, [this, claimed] {
+                {
+                    shared_lock<shared_mutex> lock(mutex_);
+                    if (claimed != generation_) return;   // A reconnect or refresh() resynced meanwhile
+                }
+                resync();
+            });
+        }
+
+        // ------ Notifications ------
+        // Raw order channels carry one order; aggregated ones an array
+        void onOrders(string_view data) {
+            unique_lock<shared_mutex> lock(mutex_);
+            forEachObject(data, [&](string_view order) { applyOrderLocked(order, 0); });
+        }
+
+        void onTrades(string_view data) {
+            unique_lock<shared_mutex> lock(mutex_);
+            forEachObject(data, [&](string_view trade) { applyFillLocked(trade); });
+        }
+
+        // {"instrument_name": ..., "orders": [...], "trades": [...], "positions": [...]};
+        // orders and trades also arrive on their own channels
+        void onChanges(string_view data) {
+            static const jsonScanner fields{"positions"};
+            jsonValue positions;
+            fields.scan(data, &positions);
+            if (!positions.found()) return;
+            unique_lock<shared_mutex> lock(mutex_);
+            forEachElement(positions.raw, [&](const jsonValue& position) {
+                applyPositionLocked(position.raw, 0);
+            });
+        }
+
+        void onPortfolio(string_view data) {
+            static const jsonScanner fields{"currency"};
+            jsonValue currency;
+            fields.scan(data, &currency);
+            if (!currency.isString()) return;
+            unique_lock<shared_mutex> lock(mutex_);
+            portfolio_[currency.text()] = string(data);
+        }
+
+        // ------ Apply (caller holds the write lock) ------
+        // Notifications pass generation 0; a resync passes its own. Returns the order id.
+        string applyOrderLocked(string_view text, long long resyncGeneration) {
+            static const jsonScanner fields{"order_id", "instrument_name", "direction", "order_state", "label",
+                                            "price", "amount", "filled_amount", "last_update_timestamp"};
+            jsonValue values[9];
+            fields.scan(text, values);
+            if (!values[0].isString()) return "";
+
+            orderRecord& record = orders_[values[0].text()];
+            long long updated = values[8].integer();
+            if (!record.orderId.empty() && updated < record.updated) return record.orderId;   // Older than what we have
+            if (resyncGeneration > 0 && record.notifiedIn >= resyncGeneration) return record.orderId;
+            bool wasOpen = record.orderId.empty() || record.isOpen();
+
+            record.orderId = values[0].text();
+            record.instrument = values[1].text();
+            record.direction = values[2].text();
+            record.state = values[3].text();
+            record.label = values[4].text();
+            record.price = values[5].number();       // "market_price" for market orders reads as 0
+            record.amount = values[6].number();
+            record.filledAmount = values[7].number();
+            record.updated = updated;
+            record.raw.assign(text);
+            record.pending = false;
+            if (resyncGeneration == 0) record.notifiedIn = generation_;
+
+            if (orderListener_) orderListener_(record);
+            string orderId = record.orderId;
+            if (wasOpen && !record.isOpen()) {
+                closed_.push_back(orderId);
+                trimClosedLocked();
+            }
+            return orderId;
+        }
+
+        void trimClosedLocked() {
+            while (closed_.size() > MAX_CLOSED_ORDERS) {
+                auto it = orders_.find(closed_.front());
+                if (it != orders_.end() && !it->second.isOpen()) orders_.erase(it);
+                closed_.pop_front();
+            }
+        }
+
+        // Notifications pass generation 0 and always apply; a resync only overwrites positions
+        // no notification has touched since it was requested. Returns the instrument.
+        string applyPositionLocked(string_view text, long long resyncGeneration) {
+            static const jsonScanner fields{"instrument_name", "size", "average_price"};
+            jsonValue values[3];
+            fields.scan(text, values);
+            if (!values[0].isString()) return "";
+
+            positionRecord& record = positions_[values[0].text()];
+            if (resyncGeneration > 0 && record.notifiedIn >= resyncGeneration) return record.instrument;
+            record.instrument = values[0].text();
+            record.size = values[1].number();
+            record.averagePrice = values[2].number();
+            record.raw.assign(text);
+            if (resyncGeneration == 0) record.notifiedIn = generation_;
+            if (positionListener_) positionListener_(record.instrument, record.size);
+            return record.instrument;
+        }
+
+        void applyFillLocked(string_view text) {
+            static const jsonScanner fields{"trade_id", "order_id", "instrument_name", "direction", "price", "amount"};
+            jsonValue values[6];
+            fields.scan(text, values);
+            if (!values[0].found()) return;
+
+            fillRecord fill;
+            fill.tradeId = values[0].text();
+            fill.orderId = values[1].text();
+            fill.instrument = values[2].text();
+            fill.direction = values[3].text();
+            fill.price = values[4].number();
+            fill.amount = values[5].number();
+            fill.raw.assign(text);
+            fills_.push_back(move(fill));
+            if (fills_.size() > MAX_CACHED_FILLS) fills_.pop_front();
+        }
+
+        // Calls `visit` for a single object or for each object of an array
+        template <typename Visitor>
+        static void forEachObject(string_view data, Visitor&& visit) {
+            size_t start = data.find_first_not_of(" \t\r\n");
+            if (start == string_view::npos) return;
+            if (data[start] == '[') {
+                forEachElement(data, [&](const jsonValue& element) { visit(element.raw); });
+            } else {
+                visit(data);
+            }
+        }
+};
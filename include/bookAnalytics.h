@@ -0,0 +1,174 @@
+#pragma once
+#include <string>
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <limits>
+#include "orderBook.h"
+#include "bookFrame.h"
+#include "wireCodec.h"
+
+using namespace std;
+
+const size_t ANALYTICS_RESUM_INTERVAL = 4096;   // Level changes between full re-sums of the running totals
+
+// Metrics over the top `depth` levels of one book. NaN marks a metric that is undefined
+// because a side is empty.
+struct bookMetrics {
+    double mid;
+    double spread;
+    double microprice;   // Best prices weighted by the opposite side's best amount
+    double imbalance;    // (bid amount - ask amount) / (bid amount + ask amount) over the top levels
+    double bidVwap;      // Amount-weighted average price of the top bid levels
+    double askVwap;
+
+    bool operator==(const bookMetrics& other) const {
+        return memcmp(this, &other, sizeof(bookMetrics)) == 0;   // NaN compares equal to itself
+    }
+};
+
+static_assert(sizeof(bookMetrics) == 48, "bookMetrics is written to the wire as six doubles");
+
+// ======== bookAnalytics Class ========
+// Mid, spread, microprice, top-N imbalance and depth-weighted VWAP of one book, kept
+// current from the level changes bookFeed reports instead of rescanning the book. A change
+// inside the top `depth` adjusts the running amount and notional sums of its side by the
+// level itself and, for an insert or a removal, by the one level it pushes out of or pulls
+// into the window. The sums are rebuilt from the book on every snapshot and every
+// ANALYTICS_RESUM_INTERVAL changes, so rounding never accumulates. Used from the feed's
+// thread only.
+class bookAnalytics {
+    public:
+        bookAnalytics(uint32_t instrumentId, int depth) : instrumentId_(instrumentId), depth_(max(1, depth)) {}
+
+        // Applies one level change reported by orderBook::update; `book` already holds it
+        void onLevel(const orderBook& book, bookSide side, double price, size_t rank, double previous, double amount) {
+            if (!primed_ || rank >= depth_) return;
+            windowSums& sums = (side == bookSide::bid) ? bids_ : asks_;
+            if (previous > 0 && amount > 0) {
+                add(sums, price, amount - previous);
+            } else if (amount > 0) {
+                add(sums, price, amount);
+                if (book.depth(side) > depth_) subtract(sums, book.level(side, depth_));
+            } else if (previous > 0) {
+                add(sums, price, -previous);
+                if (book.depth(side) >= depth_) add(sums, book.level(side, depth_ - 1));
+            } else {
+                return;
+            }
+            if (++changes_ >= ANALYTICS_RESUM_INTERVAL) rebuild(book);
+        }
+
+        // Recomputes the sums from the book; needed first and after every snapshot
+        void rebuild(const orderBook& book) {
+            bids_ = sumSide(book, bookSide::bid);
+            asks_ = sumSide(book, bookSide::ask);
+            changes_ = 0;
+            primed_ = true;
+        }
+
+        bool primed() const { return primed_; }
+        int depth() const { return (int)depth_; }
+
+        // O(1): best levels from the book, everything else from the running sums
+        bookMetrics metrics(const orderBook& book) const {
+            const double undefined = numeric_limits<double>::quiet_NaN();
+            bookMetrics out{undefined, undefined, undefined, undefined, undefined, undefined};
+            bool hasBid = book.depth(bookSide::bid) > 0;
+            bool hasAsk = book.depth(bookSide::ask) > 0;
+            if (hasBid && hasAsk) {
+                const bookLevel& bid = book.level(bookSide::bid, 0);
+                const bookLevel& ask = book.level(bookSide::ask, 0);
+                out.mid = (bid.price + ask.price) / 2;
+                out.spread = ask.price - bid.price;
+                out.microprice = (bid.price * ask.amount + ask.price * bid.amount) / (bid.amount + ask.amount);
+            }
+            double total = bids_.amount + asks_.amount;
+            if (total > 0) out.imbalance = (bids_.amount - asks_.amount) / total;
+            if (bids_.amount > 0) out.bidVwap = bids_.notional / bids_.amount;
+            if (asks_.amount > 0) out.askVwap = asks_.notional / asks_.amount;
+            return out;
+        }
+
+        // Writes the current metrics as JSON text or, when `binary`, as a bookFrameType::analytics
+        // frame. Returns false, writing nothing, when they did not change since the last call.
+        bool encode(const orderBook& book, const string& symbol, long long sequence, long long timestamp,
+                    bool binary, string& out) {
+            bookMetrics current = metrics(book);
+            if (published_ && current == last_) return false;
+            last_ = current;
+            published_ = true;
+
+            if (binary) {
+                writeFrame(out, sequence, timestamp, current);
+                return true;
+            }
+            out.clear();
+            out.append(R"({"method":"analytics","symbol":)");
+            appendJsonString(out, symbol);
+            out.append(R"(,"depth":)");
+            appendJsonNumber(out, (long long)depth_);
+            out.append(R"(,"change_id":)");
+            appendJsonNumber(out, sequence);
+            out.append(R"(,"timestamp":)");
+            appendJsonNumber(out, timestamp);
+            out.append(R"(,"mid":)");
+            appendJsonNumber(out, current.mid);
+            out.append(R"(,"spread":)");
+            appendJsonNumber(out, current.spread);
+            out.append(R"(,"microprice":)");
+            appendJsonNumber(out, current.microprice);
+            out.append(R"(,"imbalance":)");
+            appendJsonNumber(out, current.imbalance);
+            out.append(R"(,"bid_vwap":)");
+            appendJsonNumber(out, current.bidVwap);
+            out.append(R"(,"ask_vwap":)");
+            appendJsonNumber(out, current.askVwap);
+            out.push_back('}');
+            return true;
+        }
+
+    private:
+        // Running totals over the levels of one side inside the window
+        struct windowSums {
+            double amount = 0;
+            double notional = 0;   // Sum of price * amount
+        };
+
+        uint32_t instrumentId_;
+        size_t depth_;
+        bool primed_ = false;
+        size_t changes_ = 0;       // Incremental changes since the last rebuild
+        windowSums bids_, asks_;
+        bool published_ = false;
+        bookMetrics last_{};
+
+        static void add(windowSums& sums, double price, double amount) {
+            sums.amount += amount;
+            sums.notional += price * amount;
+        }
+        static void add(windowSums& sums, const bookLevel& level) { add(sums, level.price, level.amount); }
+        static void subtract(windowSums& sums, const bookLevel& level) { add(sums, level.price, -level.amount); }
+
+        windowSums sumSide(const orderBook& book, bookSide side) const {
+            windowSums sums;
+            size_t count = min(depth_, book.depth(side));
+            for (size_t rank = 0; rank < count; ++rank) add(sums, book.level(side, rank));
+            return sums;
+        }
+
+        // Frame header with no levels, followed by the six metrics in bookMetrics order
+        void writeFrame(string& out, long long sequence, long long timestamp, const bookMetrics& current) const {
+            bookFrameHeader header{};
+            header.type = (uint8_t)bookFrameType::analytics;
+            header.version = BOOK_FRAME_VERSION;
+            header.depth = (uint16_t)depth_;
+            header.instrumentId = instrumentId_;
+            header.sequence = (uint64_t)sequence;
+            header.timestamp = timestamp;
+
+            out.resize(sizeof(header) + sizeof(current));
+            memcpy(&out[0], &header, sizeof(header));
+            memcpy(&out[sizeof(header)], &current, sizeof(current));
+        }
+};
@@ -0,0 +1,143 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+#include "orderBook.h"
+#include "wireCodec.h"
+
+using namespace std;
+
+// Result of applying one `book.{instrument}.{interval}` notification
+enum class feedStatus {
+    snapshot,   // Book was rebuilt from a full snapshot
+    applied,    // Incremental change applied in sequence
+    gap,        // prev_change_id did not match; book is stale until the next snapshot
+    ignored     // Change received before any snapshot, or malformed data
+};
+
+// Default level observer for bookFeed::apply
+struct ignoreLevels {
+    void operator()(bookSide, double, size_t, double, double) const {}
+};
+
+// ======== bookFeed Class ========
+// Local copy of one instrument's book, kept current from Deribit's incremental
+// book channels. Every change carries `prev_change_id`, which must equal the
+// `change_id` of the last applied message; anything else is reported as a gap.
+class bookFeed {
+    public:
+        explicit bookFeed(const string& instrument) : instrument_(instrument) {}
+
+        // Applies the raw `data` object of a book notification. Fields are read with one
+        // scan of the text and levels go straight into the book, without a JSON DOM.
+        // `observe(side, price, rank, previous, amount)` sees every level right after it
+        // changed, with its rank and former amount as reported by orderBook::update.
+        template <typename LevelObserver = ignoreLevels>
+        feedStatus apply(string_view data, LevelObserver&& observe = LevelObserver()) {
+            static const jsonScanner fields{"type", "change_id", "prev_change_id", "timestamp", "bids", "asks"};
+            jsonValue values[6];
+            fields.scan(data, values);
+            const jsonValue& type = values[0];
+            const jsonValue& changeIdValue = values[1];
+            const jsonValue& prevChangeIdValue = values[2];
+            const jsonValue& bids = values[4];
+            const jsonValue& asks = values[5];
+            if (!changeIdValue.found() || !bids.found() || !asks.found()) {
+                return feedStatus::ignored;
+            }
+
+            long long changeId = changeIdValue.integer();
+            bool isSnapshot = type.view() == "snapshot";
+
+            if (isSnapshot) {
+                book_.clear();
+            } else {
+                if (!synced_) return feedStatus::ignored;  // Waiting for a snapshot
+                long long prevChangeId = prevChangeIdValue.integer(-1);
+                if (prevChangeId != changeId_) {
+                    synced_ = false;
+                    return feedStatus::gap;
+                }
+            }
+
+            applySide(bids.raw, bookSide::bid, observe);
+            applySide(asks.raw, bookSide::ask, observe);
+
+            changeId_ = changeId;
+            book_.setChangeId(changeId);
+            timestamp_ = values[3].integer();
+            synced_ = true;
+            return isSnapshot ? feedStatus::snapshot : feedStatus::applied;
+        }
+
+        // Writes the top `depth` levels into `out` in the same shape as a
+        // `public/get_order_book` response and returns it
+        const string& writeTop(int depth, string& out) const {
+            return writeTop(depth, out, scratch_);
+        }
+
+        // Same, with caller-owned snapshot storage, for readers other than the writer's thread
+        const string& writeTop(int depth, string& out, vector<bookLevel>& scratch) const {
+            out.clear();
+            out.append(R"({"jsonrpc":"2.0","result":{"instrument_name":)");
+            appendJsonString(out, instrument_);
+            out.append(R"(,"timestamp":)");
+            appendJsonNumber(out, timestamp_);
+            out.append(R"(,"change_id":)");
+            appendJsonNumber(out, changeId_);
+            out.append(R"(,"bids":)");
+            writeSide(bookSide::bid, depth, out, scratch);
+            out.append(R"(,"asks":)");
+            writeSide(bookSide::ask, depth, out, scratch);
+            out.append("}}");
+            return out;
+        }
+
+        bool synced() const { return synced_; }
+        long long changeId() const { return changeId_; }
+        long long timestamp() const { return timestamp_; }
+        const string& instrument() const { return instrument_; }
+        const orderBook& book() const { return book_; }
+
+    private:
+        string instrument_;
+        orderBook book_;
+        mutable vector<bookLevel> scratch_;          // Reused snapshot buffer
+        long long changeId_ = 0;
+        long long timestamp_ = 0;
+        bool synced_ = false;
+
+        // Entries are ["new" | "change" | "delete", price, amount]
+        template <typename LevelObserver>
+        void applySide(string_view levels, bookSide side, LevelObserver& observe) {
+            forEachElement(levels, [&](const jsonValue& level) {
+                jsonValue fields[3];
+                size_t count = 0;
+                forEachElement(level.raw, [&](const jsonValue& field) {
+                    if (count < 3) fields[count] = field;
+                    ++count;
+                });
+                if (count < 3) return;
+                double price = fields[1].number();
+                double amount = (fields[0].view() == "delete") ? 0 : fields[2].number();
+                double previous;
+                size_t rank = book_.update(side, price, amount, &previous);
+                observe(side, price, rank, previous, amount);
+            });
+        }
+
+        void writeSide(bookSide side, int depth, string& out, vector<bookLevel>& scratch) const {
+            if ((int)scratch.size() < depth) scratch.resize(depth);
+            size_t count = book_.snapshot(side, scratch.data(), depth);
+            out.push_back('[');
+            for (size_t i = 0; i < count; ++i) {
+                if (i) out.push_back(',');
+                out.push_back('[');
+                appendJsonNumber(out, scratch[i].price);
+                out.push_back(',');
+                appendJsonNumber(out, scratch[i].amount);
+                out.push_back(']');
+            }
+            out.push_back(']');
+        }
+};
\ No newline at end of file
@@ -0,0 +1,153 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include "orderBook.h"
+#include "wireCodec.h"
+
+using namespace std;
+
+const string BOOK_FRAME_PROTOCOL = "deribit.book.v1";   // WebSocket subprotocol that selects binary frames
+const uint8_t BOOK_FRAME_VERSION = 1;
+
+enum class bookFrameType : uint8_t {
+    snapshot = 1,   // Complete top of book; replaces whatever the client holds
+    delta = 2,      // Levels changed since the frame whose sequence is prevSequence; amount 0 removes
+    analytics = 3   // No levels; followed by six doubles of book metrics (see bookAnalytics.h)
+};
+
+// Fixed frame header, followed by bidCount then askCount levels of { double price; double amount; },
+// best level first on both sides. All fields are in host byte order (little-endian on every
+// supported platform).
+struct bookFrameHeader {
+    uint8_t type;              // bookFrameType
+    uint8_t version;           // BOOK_FRAME_VERSION
+    uint16_t depth;            // Depth of the subscription the frame belongs to
+    uint16_t bidCount;
+    uint16_t askCount;
+    uint32_t instrumentId;     // Announced in the subscribe reply
+    uint32_t reserved;
+    uint64_t sequence;         // Deribit change_id of the book described
+    uint64_t prevSequence;     // Sequence a delta applies on top of; 0 for snapshots
+    int64_t timestamp;         // Exchange timestamp in milliseconds
+};
+
+static_assert(sizeof(bookFrameHeader) == 40, "bookFrameHeader must stay 40 bytes");
+static_assert(sizeof(bookLevel) == 16, "bookLevel is written to the wire as two doubles");
+
+// Reads one side of a `public/get_order_book` result, `[[price, amount], ...]`, into `out`
+inline void readBookLevels(string_view levels, vector<bookLevel>& out) {
+    out.clear();
+    forEachElement(levels, [&](const jsonValue& level) {
+        jsonValue fields[2];
+        size_t count = 0;
+        forEachElement(level.raw, [&](const jsonValue& field) {
+            if (count < 2) fields[count] = field;
+            ++count;
+        });
+        if (count >= 2) out.push_back({fields[0].number(), fields[1].number()});
+    });
+}
+
+// ======== bookFrameEncoder Class ========
+// Binary frames for one subscription group. The encoder remembers the levels it last
+// published, so an update is usually the few levels that changed rather than the whole
+// top of book. Each update is also encoded as a snapshot, which the send queue falls back
+// to for a client that has not received the previous frame. Used from one thread only.
+class bookFrameEncoder {
+    public:
+        bookFrameEncoder(uint32_t instrumentId, int depth) : instrumentId_(instrumentId), depth_(depth) {}
+
+        // Encodes the top of `book`; see the overload below
+        bool encode(const orderBook& book, long long sequence, long long timestamp, string& snapshot, string& update) {
+            bids_.resize(depth_);
+            asks_.resize(depth_);
+            bids_.resize(book.snapshot(bookSide::bid, bids_.data(), depth_));
+            asks_.resize(book.snapshot(bookSide::ask, asks_.data(), depth_));
+            return encode(bids_, asks_, sequence, timestamp, snapshot, update);
+        }
+
+        // Writes the full top of book into `snapshot` and the change since the last published
+        // frame into `update` (itself a snapshot the first time). Returns false, publishing
+        // nothing, when the top `depth` levels did not change.
+        bool encode(const vector<bookLevel>& bids, const vector<bookLevel>& asks,
+                    long long sequence, long long timestamp, string& snapshot, string& update) {
+            size_t bidCount = min(bids.size(), (size_t)depth_);
+            size_t askCount = min(asks.size(), (size_t)depth_);
+
+            if (published_) {
+                changedBids_.clear();
+                changedAsks_.clear();
+                diffSide(lastBids_, bids.data(), bidCount, true, changedBids_);
+                diffSide(lastAsks_, asks.data(), askCount, false, changedAsks_);
+                if (changedBids_.empty() && changedAsks_.empty()) return false;
+                writeFrame(update, bookFrameType::delta, sequence, lastSequence_, timestamp,
+                           changedBids_.data(), changedBids_.size(), changedAsks_.data(), changedAsks_.size());
+            }
+            writeFrame(snapshot, bookFrameType::snapshot, sequence, 0, timestamp, bids.data(), bidCount, asks.data(), askCount);
+            if (!published_) update = snapshot;
+
+            lastBids_.assign(bids.begin(), bids.begin() + bidCount);
+            lastAsks_.assign(asks.begin(), asks.begin() + askCount);
+            lastSequence_ = (uint64_t)sequence;
+            published_ = true;
+            return true;
+        }
+
+        // Makes the next frame a full snapshot, e.g. once the upstream book was rebuilt after a gap
+        void reset() {
+            published_ = false;
+        }
+
+    private:
+        uint32_t instrumentId_;
+        int depth_;
+        bool published_ = false;
+        uint64_t lastSequence_ = 0;
+        vector<bookLevel> lastBids_, lastAsks_;          // Levels as the clients last saw them
+        vector<bookLevel> bids_, asks_;                  // Reused snapshot buffers
+        vector<bookLevel> changedBids_, changedAsks_;    // Reused delta buffers
+
+        // Merges two best-first sides: new or resized levels are emitted as they are now,
+        // levels that left the top as amount 0
+        static void diffSide(const vector<bookLevel>& before, const bookLevel* after, size_t afterCount,
+                             bool descending, vector<bookLevel>& out) {
+            auto better = [descending](double lhs, double rhs) { return descending ? lhs > rhs : lhs < rhs; };
+            size_t i = 0, j = 0;
+            while (i < before.size() || j < afterCount) {
+                if (j == afterCount || (i < before.size() && better(before[i].price, after[j].price))) {
+                    out.push_back({before[i++].price, 0});
+                } else if (i == before.size() || better(after[j].price, before[i].price)) {
+                    out.push_back(after[j++]);
+                } else {
+                    if (before[i].amount != after[j].amount) out.push_back(after[j]);
+                    ++i;
+                    ++j;
+                }
+            }
+        }
+
+        void writeFrame(string& out, bookFrameType type, long long sequence, uint64_t prevSequence, long long timestamp,
+                        const bookLevel* bids, size_t bidCount, const bookLevel* asks, size_t askCount) const {
+            bookFrameHeader header{};
+            header.type = (uint8_t)type;
+            header.version = BOOK_FRAME_VERSION;
+            header.depth = (uint16_t)depth_;
+            header.bidCount = (uint16_t)bidCount;
+            header.askCount = (uint16_t)askCount;
+            header.instrumentId = instrumentId_;
+            header.sequence = (uint64_t)sequence;
+            header.prevSequence = prevSequence;
+            header.timestamp = timestamp;
+
+            out.resize(sizeof(header) + (bidCount + askCount) * sizeof(bookLevel));
+            char* cursor = &out[0];
+            memcpy(cursor, &header, sizeof(header));
+            cursor += sizeof(header);
+            if (bidCount) memcpy(cursor, bids, bidCount * sizeof(bookLevel));
+            cursor += bidCount * sizeof(bookLevel);
+            if (askCount) memcpy(cursor, asks, askCount * sizeof(bookLevel));
+        }
+};
@@ -0,0 +1,387 @@
+#pragma once
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <functional>
+#include <algorithm>
+#include <filesystem>
+#include <cstring>
+#include <cstdint>
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+const char CAPTURE_MAGIC[8] = {'D', 'B', 'T', 'C', 'A', 'P', '0', '1'};
+const uint32_t CAPTURE_VERSION = 1;
+const size_t CAPTURE_DEFAULT_SEGMENT_BYTES = 64 << 20;   // 64 MB per segment file
+const size_t CAPTURE_ALIGN = 8;                           // Records start on 8-byte boundaries
+
+// Segment layout: this header, then records back to back. A record with size 0 (the
+// zero-filled tail of a segment that was never closed) marks the end of the data.
+struct captureSegmentHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t headerBytes;     // Offset of the first record
+    uint64_t sequence;        // Segment number, also in the file name
+    uint64_t createdNs;       // Unix time in nanoseconds
+    uint8_t reserved[32];
+};
+
+struct captureRecordHeader {
+    uint64_t timestampNs;     // Unix time the message was received, in nanoseconds
+    uint32_t size;            // Payload bytes that follow
+    uint32_t reserved;
+};
+
+static_assert(sizeof(captureSegmentHeader) == 64, "segment header must stay 64 bytes");
+static_assert(sizeof(captureRecordHeader) == 16, "record header must stay 16 bytes");
+
+// One captured message; the payload points into a mapped segment
+struct captureRecord {
+    uint64_t timestampNs;
+    string_view payload;
+};
+
+// ======== mappedFile Class ========
+// A file mapped into memory, read-only or read-write at a fixed size
+class mappedFile {
+    public:
+        mappedFile() = default;
+        ~mappedFile() { close(); }
+
+        mappedFile(const mappedFile&) = delete;
+        mappedFile& operator=(const mappedFile&) = delete;
+
+        // Creates (or truncates) `path` at `bytes` and maps it for writing
+        bool create(const string& path, size_t bytes) {
+            return open(path, bytes, true);
+        }
+
+        // Maps an existing file for reading
+        bool openRead(const string& path) {
+            error_code ec;
+            size_t bytes = (size_t)filesystem::file_size(path, ec);
+            if (ec || bytes == 0) return false;
+            return open(path, bytes, false);
+        }
+
+        // Unmaps the file; a writable file is first cut down to `keepBytes`
+        void close(size_t keepBytes = SIZE_MAX) {
+            if (!data_) return;
+#if defined(_WIN32)
+            UnmapViewOfFile(data_);
+            CloseHandle(mapping_);
+            if (writable_ && keepBytes < size_) {
+                LARGE_INTEGER end;
+                end.QuadPart = (LONGLONG)keepBytes;
+                SetFilePointerEx(file_, end, nullptr, FILE_BEGIN);
+                SetEndOfFile(file_);
+            }
+            CloseHandle(file_);
+#else
+            munmap(data_, size_);
+            if (writable_ && keepBytes < size_) {
+                if (ftruncate(fd_, (off_t)keepBytes) != 0) cerr << "Capture Error: unable to trim segment" << endl;
+            }
+            ::close(fd_);
+#endif
+            data_ = nullptr;
+            size_ = 0;
+        }
+
+        char* data() const { return data_; }
+        size_t size() const { return size_; }
+
+    private:
+        char* data_ = nullptr;
+        size_t size_ = 0;
+        bool writable_ = false;
+#if defined(_WIN32)
+        HANDLE file_ = INVALID_HANDLE_VALUE;
+        HANDLE mapping_ = nullptr;
+#else
+        int fd_ = -1;
+#endif
+
+        bool open(const string& path, size_t bytes, bool writable) {
+            close();
+            writable_ = writable;
+#if defined(_WIN32)
+            file_ = CreateFileA(path.c_str(), writable ? (GENERIC_READ | GENERIC_WRITE) : GENERIC_READ,
+                                FILE_SHARE_READ, nullptr, writable ? CREATE_ALWAYS : OPEN_EXISTING,
+                                FILE_ATTRIBUTE_NORMAL, nullptr);
+            if (file_ == INVALID_HANDLE_VALUE) return false;
+            mapping_ = CreateFileMappingA(file_, nullptr, writable ? PAGE_READWRITE : PAGE_READONLY,
+                                          (DWORD)((uint64_t)bytes >> 32), (DWORD)(bytes & 0xFFFFFFFF), nullptr);
+            if (!mapping_) {
+                CloseHandle(file_);
+                return false;
+            }
+            data_ = (char*)MapViewOfFile(mapping_, writable ? FILE_MAP_WRITE : FILE_MAP_READ, 0, 0, bytes);
+            if (!data_) {
+                CloseHandle(mapping_);
+                CloseHandle(file_);
+                return false;
+            }
+#else
+            fd_ = ::open(path.c_str(), writable ? (O_RDWR | O_CREAT | O_TRUNC) : O_RDONLY, 0644);
+            if (fd_ < 0) return false;
+            if (writable && ftruncate(fd_, (off_t)bytes) != 0) {   // Sparse, zero-filled
+                ::close(fd_);
+                return false;
+            }
+            void* mapped = mmap(nullptr, bytes, writable ? (PROT_READ | PROT_WRITE) : PROT_READ, MAP_SHARED, fd_, 0);
+            if (mapped == MAP_FAILED) {
+                ::close(fd_);
+                return false;
+            }
+            data_ = (char*)mapped;
+#endif
+            size_ = bytes;
+            return true;
+        }
+};
+
+// Segment file name for sequence number `sequence`
+inline string captureSegmentName(uint64_t sequence) {
+    char name[32];
+    snprintf(name, sizeof(name), "capture-%08llu.seg", (unsigned long long)sequence);
+    return name;
+}
+
+// Segment files in `dir`, oldest first
+inline vector<filesystem::path> captureSegments(const string& dir) {
+    vector<filesystem::path> segments;
+    error_code ec;
+    for (auto& entry : filesystem::directory_iterator(dir, ec)) {
+        string name = entry.path().filename().string();
+        if (name.rfind("capture-", 0) == 0 && entry.path().extension() == ".seg") {
+            segments.push_back(entry.path());
+        }
+    }
+    sort(segments.begin(), segments.end());
+    return segments;
+}
+
+// ======== captureWriter Class ========
+// Appends upstream messages to memory-mapped segment files in a directory. Appending is
+// a short critical section (a bump of the write offset and one memcpy into the mapping);
+// the kernel writes pages back in the background, so the hot path never calls write().
+// Segments roll when full and are trimmed to their used length when closed. A new
+// writer continues numbering after the segments already in the directory.
+class captureWriter {
+    public:
+        explicit captureWriter(const string& dir, size_t segmentBytes = CAPTURE_DEFAULT_SEGMENT_BYTES)
+            : dir_(dir), segmentBytes_(max(segmentBytes, (size_t)(1 << 16))) {
+            error_code ec;
+            filesystem::create_directories(dir_, ec);
+            vector<filesystem::path> existing = captureSegments(dir_);
+            if (!existing.empty()) {
+                string stem = existing.back().stem().string();   // capture-00000042
+                try { sequence_ = stoull(stem.substr(8)); } catch (const exception&) {}
+            }
+
+            // Receive times are steady-clock readings; this maps them onto wall-clock nanoseconds
+            auto wall = chrono::duration_cast<chrono::nanoseconds>(chrono::system_clock::now().time_since_epoch());
+            auto steady = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch());
+            steadyToWallNs_ = wall.count() - steady.count();
+        }
+
+        ~captureWriter() {
+            lock_guard<mutex> lock(mutex_);
+            segment_.close(offset_);
+        }
+
+        captureWriter(const captureWriter&) = delete;
+        captureWriter& operator=(const captureWriter&) = delete;
+
+        void append(string_view payload, chrono::steady_clock::time_point received) {
+            size_t need = align(sizeof(captureRecordHeader) + payload.size());
+            captureRecordHeader header{};
+            header.timestampNs = (uint64_t)(chrono::duration_cast<chrono::nanoseconds>(received.time_since_epoch()).count()
+                                            + steadyToWallNs_);
+            header.size = (uint32_t)payload.size();
+
+            lock_guard<mutex> lock(mutex_);
+            if (!segment_.data() || offset_ + need > segment_.size()) {
+                if (!roll(need)) {
+                    dropped_.fetch_add(1, memory_order_relaxed);
+                    return;
+                }
+            }
+            char* at = segment_.data() + offset_;
+            memcpy(at + sizeof(header), payload.data(), payload.size());
+            memcpy(at, &header, sizeof(header));
+            offset_ += need;
+            records_.fetch_add(1, memory_order_relaxed);
+        }
+
+        uint64_t records() const { return records_.load(memory_order_relaxed); }
+        uint64_t dropped() const { return dropped_.load(memory_order_relaxed); }
+        const string& directory() const { return dir_; }
+
+    private:
+        string dir_;
+        size_t segmentBytes_;
+        long long steadyToWallNs_ = 0;
+
+        mutex mutex_;            // Protects the active segment
+        mappedFile segment_;
+        size_t offset_ = 0;      // Next write position in segment_
+        uint64_t sequence_ = 0;  // Last segment number used
+
+        atomic<uint64_t> records_{0};
+        atomic<uint64_t> dropped_{0};   // Messages lost because a segment could not be created
+
+        static size_t align(size_t bytes) {
+            return (bytes + CAPTURE_ALIGN - 1) & ~(CAPTURE_ALIGN - 1);
+        }
+
+        // Closes the active segment and opens the next one, large enough for `need` bytes
+        bool roll(size_t need) {
+            segment_.close(offset_);
+            size_t bytes = max(segmentBytes_, sizeof(captureSegmentHeader) + need);
+            string path = (filesystem::path(dir_) / captureSegmentName(++sequence_)).string();
+            if (!segment_.create(path, bytes)) {
+                cerr << "Capture Error: unable to create " << path << endl;
+                return false;
+            }
+
+            captureSegmentHeader header{};
+            memcpy(header.magic, CAPTURE_MAGIC, sizeof(header.magic));
+            header.version = CAPTURE_VERSION;
+            header.headerBytes = sizeof(captureSegmentHeader);
+            header.sequence = sequence_;
+            header.createdNs = (uint64_t)chrono::duration_cast<chrono::nanoseconds>(
+                chrono::system_clock::now().time_since_epoch()).count();
+            memcpy(segment_.data(), &header, sizeof(header));
+            offset_ = sizeof(captureSegmentHeader);
+            return true;
+        }
+};
+
+// ======== captureReader Class ========
+// Walks every record of every segment in a directory, oldest first, without copying
+class captureReader {
+    public:
+        explicit captureReader(const string& dir) : segments_(captureSegments(dir)) {}
+
+        // Next record; its payload stays valid until the reader moves past its segment
+        bool next(captureRecord& out) {
+            while (true) {
+                if (segment_.data() && offset_ + sizeof(captureRecordHeader) <= segment_.size()) {
+                    captureRecordHeader header;
+                    memcpy(&header, segment_.data() + offset_, sizeof(header));
+                    size_t end = offset_ + sizeof(header) + header.size;
+                    if (header.size > 0 && end <= segment_.size()) {
+                        out.timestampNs = header.timestampNs;
+                        out.payload = string_view(segment_.data() + offset_ + sizeof(header), header.size);
+                        offset_ = (end + CAPTURE_ALIGN - 1) & ~(CAPTURE_ALIGN - 1);
+                        return true;
+                    }
+                }
+                if (!openNext()) return false;
+            }
+        }
+
+        size_t segment_count() const {
+            return segments_.size();
+        }
+
+    private:
+        vector<filesystem::path> segments_;
+        size_t nextSegment_ = 0;
+        mappedFile segment_;
+        size_t offset_ = 0;
+
+        bool openNext() {
+            segment_.close();
+            while (nextSegment_ < segments_.size()) {
+                string path = segments_[nextSegment_++].string();
+                if (!segment_.openRead(path) || segment_.size() < sizeof(captureSegmentHeader)) continue;
+
+                captureSegmentHeader header;
+                memcpy(&header, segment_.data(), sizeof(header));
+                if (memcmp(header.magic, CAPTURE_MAGIC, sizeof(header.magic)) != 0 || header.version != CAPTURE_VERSION) {
+                    cerr << "Capture Error: " << path << " is not a capture segment" << endl;
+                    segment_.close();
+                    continue;
+                }
+                offset_ = header.headerBytes;
+                return true;
+            }
+            return false;
+        }
+};
+
+// ======== captureReplayer Class ========
+// Plays a capture directory back on its own thread. `speed` 1 reproduces the original
+// timing, 10 plays ten times faster and 0 plays as fast as the consumer allows.
+class captureReplayer {
+    public:
+        using deliverFn = function<void(string_view, chrono::steady_clock::time_point)>;
+
+        captureReplayer(const string& dir, double speed) : dir_(dir), speed_(max(0.0, speed)) {}
+
+        ~captureReplayer() {
+            stop();
+        }
+
+        // Starts playback once; later calls do nothing
+        void start(deliverFn deliver) {
+            if (started_.exchange(true)) return;
+            thread_ = thread([this, deliver] { play(deliver); });
+        }
+
+        void stop() {
+            stopping_ = true;
+            if (thread_.joinable()) thread_.join();
+        }
+
+        bool finished() const { return finished_; }
+        uint64_t delivered() const { return delivered_.load(memory_order_relaxed); }
+
+    private:
+        string dir_;
+        double speed_;
+        thread thread_;
+        atomic<bool> started_{false};
+        atomic<bool> stopping_{false};
+        atomic<bool> finished_{false};
+        atomic<uint64_t> delivered_{0};
+
+        void play(const deliverFn& deliver) {
+            captureReader reader(dir_);
+            captureRecord record;
+            uint64_t firstNs = 0;
+            auto begin = chrono::steady_clock::now();
+
+            while (!stopping_ && reader.next(record)) {
+                if (firstNs == 0) firstNs = record.timestampNs;
+                if (speed_ > 0 && record.timestampNs > firstNs) {
+                    auto offset = chrono::nanoseconds((long long)((record.timestampNs - firstNs) / speed_));
+                    this_thread::sleep_until(begin + offset);
+                }
+                deliver(record.payload, chrono::steady_clock::now());
+                delivered_.fetch_add(1, memory_order_relaxed);
+            }
+
+            double seconds = chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+            cout << "Replay finished: " << delivered() << " messages in " << seconds << " s ("
+                 << (seconds > 0 ? delivered() / seconds : 0.0) << " msg/s)" << endl;
+            finished_ = true;
+        }
+};
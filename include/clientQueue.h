@@ -0,0 +1,121 @@
+#pragma once
+#include <string>
+#include <algorithm>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <unordered_map>
+#include <unordered_set>
+#include <websocketpp/frame.hpp>
+#include <websocketpp/message_buffer/message.hpp>
+#include <websocketpp/message_buffer/alloc.hpp>
+
+using namespace std;
+
+// Serialized update, framed once as a WebSocket message (the server's message type) and
+// shared by every connection it is written to
+using outgoingMessage = websocketpp::message_buffer::message<websocketpp::message_buffer::alloc::con_msg_manager>;
+using sharedPayload = shared_ptr<outgoingMessage>;
+
+const size_t MAX_PENDING_SYMBOLS = 1024;        // Hard cap on distinct topics waiting per client
+
+struct queuedUpdate {
+    sharedPayload payload;
+    chrono::steady_clock::time_point enqueued;  // When the upstream message behind it arrived
+};
+
+// ======== clientQueue Class ========
+// Per-connection send queue with conflation: at most one update per topic is pending,
+// so a newer book replaces an unsent older one instead of queueing behind it. Depth is
+// therefore bounded by the number of topics the client watches. The queue also tracks
+// whether a drain is scheduled, so the publisher posts at most one drain per client.
+// Topics are identified by their numeric id, so queueing an update copies no string.
+//
+// Updates that only make sense on top of the previous one (binary deltas) come with a
+// `resync` alternative. It is queued instead whenever the client would otherwise miss a
+// frame: on its first update for the topic, and after a conflation or a drop.
+class clientQueue {
+    public:
+        // Returns true when the caller must schedule a drain for this client
+        bool push(uint64_t topicId, const sharedPayload& payload, chrono::steady_clock::time_point now,
+                  const sharedPayload& resync = nullptr) {
+            lock_guard<mutex> lock(mutex_);
+            bool inSync = !resync || synced_.count(topicId);
+            auto it = latest_.find(topicId);
+            if (it != latest_.end()) {
+                it->second = queuedUpdate{resync ? resync : payload, now};   // Drop the stale book, keep its place in line
+                conflated_.fetch_add(1, memory_order_relaxed);
+            } else if (order_.size() >= MAX_PENDING_SYMBOLS) {
+                dropped_.fetch_add(1, memory_order_relaxed);
+                synced_.erase(topicId);
+                return false;
+            } else {
+                latest_.emplace(topicId, queuedUpdate{inSync ? payload : resync, now});
+                order_.push_back(topicId);
+            }
+            if (resync) synced_.insert(topicId);
+
+            if (drainScheduled_) return false;
+            drainScheduled_ = true;
+            return true;
+        }
+
+        // Takes the oldest pending update. When the queue is empty the drain is marked
+        // finished under the same lock, so a concurrent push schedules a new one.
+        bool pop(queuedUpdate& out) {
+            lock_guard<mutex> lock(mutex_);
+            if (order_.empty()) {
+                drainScheduled_ = false;
+                return false;
+            }
+            auto it = latest_.find(order_.front());
+            out = move(it->second);
+            latest_.erase(it);
+            order_.pop_front();
+            return true;
+        }
+
+        // Forgets a topic the client left: its delta chain and any update still pending
+        void forget(uint64_t topicId) {
+            lock_guard<mutex> lock(mutex_);
+            synced_.erase(topicId);
+            if (latest_.erase(topicId)) order_.erase(find(order_.begin(), order_.end(), topicId));
+        }
+
+        // Called by the drain after each send
+        void record_send(chrono::nanoseconds latency) {
+            uint64_t ns = (uint64_t)latency.count();
+            sent_.fetch_add(1, memory_order_relaxed);
+            latencyTotalNs_.fetch_add(ns, memory_order_relaxed);
+            if (ns > latencyMaxNs_.load(memory_order_relaxed)) {
+                latencyMaxNs_.store(ns, memory_order_relaxed);  // Only the drain writes this
+            }
+        }
+
+        // ------ Metrics ------
+        size_t depth() {
+            lock_guard<mutex> lock(mutex_);
+            return order_.size();
+        }
+        uint64_t conflated() const { return conflated_.load(memory_order_relaxed); }
+        uint64_t dropped() const { return dropped_.load(memory_order_relaxed); }
+        uint64_t sent() const { return sent_.load(memory_order_relaxed); }
+        uint64_t latency_total_ns() const { return latencyTotalNs_.load(memory_order_relaxed); }
+        uint64_t latency_max_ns() const { return latencyMaxNs_.load(memory_order_relaxed); }
+
+    private:
+        mutex mutex_;                                    // Protects the pending updates
+        unordered_map<uint64_t, queuedUpdate> latest_;   // <Topic id, Newest unsent update>
+        deque<uint64_t> order_;                          // Topic ids in first-enqueued order
+        unordered_set<uint64_t> synced_;                 // Topics whose delta chain the client follows
+        bool drainScheduled_ = false;
+
+        atomic<uint64_t> conflated_{0};   // Updates replaced before they were sent
+        atomic<uint64_t> dropped_{0};     // Updates rejected by MAX_PENDING_SYMBOLS
+        atomic<uint64_t> sent_{0};
+        atomic<uint64_t> latencyTotalNs_{0};
+        atomic<uint64_t> latencyMaxNs_{0};
+};
@@ -1,9 +1,24 @@
+#pragma once
 #include <unordered_map>
 #include <ctime>
 #include <iostream>
 #include <string>
+#include <memory>
+#include <future>
+#include <chrono>
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 #include <nlohmann/json.hpp>
 #include "utils.h"
+#include "orderEntry.h"
+#include "accountState.h"
+#include "riskEngine.h"
+#include "snapshotCache.h"
+#include "wireCodec.h"
 
 using namespace std;
 using json = nlohmann::json;
@@ -11,168 +26,728 @@ using json = nlohmann::json;
 // Constants for timeout and token refresh settings
 const long long DEFAULT_TIMEOUT_MS = 10000;               // 10 seconds
 const long long TOKEN_REFRESH_OFFSET_S = 60;              // 60 seconds before expiration
-const string ENV_FIlE = ".env";                           // Environment file to read credentials
+const long long TOKEN_RETRY_S = 5;                        // Wait before retrying a failed refresh
 
-// TradeManager Class: Manages authentication, token verification, and trading operations
+// REST request bodies, split once into literals around the `$` placeholders
+const payloadTemplate AUTH_PAYLOAD(R"({"method":"public/auth","params":{"grant_type":"client_credentials","client_id":$,"client_secret":$}})");
+const payloadTemplate REFRESH_PAYLOAD(R"({"method":"public/auth","params":{"grant_type":"refresh_token","refresh_token":$}})");
+const payloadTemplate ORDER_PAYLOAD(R"({"method":$,"params":{"instrument_name":$,"amount":$,"type":$}})");
+const payloadTemplate CANCEL_PAYLOAD(R"({"method":"private/cancel","params":{"order_id":$}})");
+const payloadTemplate MODIFY_PAYLOAD(R"({"method":"private/edit","params":{"order_id":$,"amount":$}})");
+const payloadTemplate MODIFY_PRICE_PAYLOAD(R"({"method":"private/edit","params":{"order_id":$,"amount":$,"price":$}})");
+const payloadTemplate CANCEL_SCOPE_PAYLOAD(R"({"method":$,"params":{$:$}})");
+const string CANCEL_ALL_PAYLOAD = R"({"method":"private/cancel_all","params":{}})";
+const string TEST_PAYLOAD = R"({"method":"public/test","params":{}})";
+const payloadTemplate ORDER_BOOK_PAYLOAD(R"({"method":"public/get_order_book","params":{"instrument_name":$}})");
+const payloadTemplate ORDER_BOOK_DEPTH_PAYLOAD(R"({"method":"public/get_order_book","params":{"instrument_name":$,"depth":$}})");
+const string POSITIONS_PAYLOAD = R"({"method":"private/get_positions","params":{}})";
+const string OPEN_ORDERS_PAYLOAD = R"({"method":"private/get_open_orders","params":{}})";
+const payloadTemplate ORDER_STATE_PAYLOAD(R"({"method":"private/get_order_state","params":{"order_id":$}})");
+
+// One operation in a batch submitted through tradeManager::submitBatch
+struct tradeOp {
+    string method;        // API method, e.g. "private/buy"
+    json params;
+
+    static tradeOp order(int buy, const string& symbol, double amount, const string& type = "market") {
+        return {(buy) ? "private/buy" : "private/sell", {{"instrument_name", symbol}, {"amount", amount}, {"type", type}}};
+    }
+    static tradeOp cancel(const string& order_id) {
+        return {"private/cancel", {{"order_id", order_id}}};
+    }
+    static tradeOp modify(const string& order_id, double amount, double price = 0) {
+        json params = {{"order_id", order_id}, {"amount", amount}};
+        if (price > 0) params["price"] = price;
+        return {"private/edit", params};
+    }
+    static tradeOp cancelAll(const cancelScope& scope) {
+        json params = json::object();
+        if (!scope.field.empty()) params[scope.field] = scope.value;
+        return {scope.method, params};
+    }
+    static tradeOp orderBook(const string& symbol, long long depth = 0) {
+        json params = {{"instrument_name", symbol}};
+        if (depth > 0) params["depth"] = depth;
+        return {"public/get_order_book", params};
+    }
+    static tradeOp positions() {
+        return {"private/get_positions", json::object()};
+    }
+
+    // {"method": ..., "params": {...}}, the shape of one line in an order stream
+    static tradeOp fromJson(const json& request) {
+        return {request.at("method").get<string>(), request.value("params", json::object())};
+    }
+
+    bool isPrivate() const {
+        return method.rfind("private/", 0) == 0;
+    }
+    bool isBuy() const {
+        return method == "private/buy";
+    }
+    // A new order, with an instrument_name to check limits against
+    bool isOrder() const {
+        return (isBuy() || method == "private/sell") && params.is_object() && params.contains("instrument_name")
+               && params["instrument_name"].is_string();
+    }
+};
+
+// One issued access token; published whole and never modified afterwards
+struct authToken {
+    string bearer;            // "Bearer <access_token>", sent as the Authorization header
+    string refreshToken;
+    long long expiresOn = 0;  // Unix time the access token stops working
+    long long refreshAt = 0;  // Unix time the background refresher renews it
+};
+
+// TradeManager Class: Manages authentication, token verification, and trading operations.
+// After the first authenticate() a background thread keeps the token fresh with its
+// refresh_token and publishes each new one with an atomic pointer swap, so order calls
+// only load the current token and never wait on an auth round trip.
 class tradeManager {
     private:
-        string authToken = "";       // Authentication token
-        long long expiresOn = 0;     // Expiration time of the authentication token
+        httpTransport transport;     // Pooled keep-alive connections to the configured endpoint
+        unique_ptr<riskEngine> risk;      // Pre-trade limits checked before every order, when configured
+        unique_ptr<accountState> account; // Order/position cache on the order WebSocket, when enabled
+        unique_ptr<orderEntry> wsOrders;  // Persistent WebSocket order entry, when enabled
+        unique_ptr<snapshotCache> books;  // Recent order book responses, when enabled
+        bookSource liveBooks;             // Local books kept by a WebSocket server, when attached
+        unordered_map<string, string> settings;  // Settings read once at construction
+        string clientId;             // Credentials from settings
+        string clientSecret;
 
-    public:
-        // Method to authenticate and generate a new authentication token
-        bool authenticate() {
-            // Read environment variables from the file
-            unordered_map<string, string> env = readEnv(ENV_FIlE);
+        // ------ Token State ------
+        shared_ptr<const authToken> token;   // Accessed only through atomic_load / atomic_store
+        thread refresher;                    // Started by the first successful authenticate()
+        mutex refresherMutex;
+        condition_variable refresherWake;
+        bool stopping = false;               // Guarded by refresherMutex
 
-            // Ensure that the necessary credentials are available
-            if (!env.count("DERIBIT_CLIENT_ID") || !env.count("DERIBIT_CLIENT_SECRET")) {
-                cerr << "Please create a '" << ENV_FIlE << "' file and add 'DERIBIT_CLIENT_ID' and 'DERIBIT_CLIENT_SECRET' to it." << endl;
-                return false;
+        // Waits for a WebSocket response with the same timeout as the REST path. The session
+        // drops a call it has not heard back on by then, so nothing is left waiting for it.
+        static string awaitResponse(future<string> response) {
+            if (response.wait_for(chrono::milliseconds(DEFAULT_TIMEOUT_MS)) != future_status::ready) {
+                return "Request Timed Out";
             }
+            return response.get();
+        }
 
-            const string CLIENT_ID = env["DERIBIT_CLIENT_ID"];
-            const string CLIENT_SECRET = env["DERIBIT_CLIENT_SECRET"];
+        // ------ Risk Checks ------
+        static double opNumber(const tradeOp& op, const char* key) {
+            auto it = op.params.find(key);
+            return (it != op.params.end() && it->is_number()) ? it->get<double>() : 0.0;
+        }
 
-            // Prepare the request payload for authentication
-            string req = "POST";
-            string url = "https://test.deribit.com/api/v2/public/auth";
-            string payload = R"({
-                "method": "public/auth",
-                "params": {
-                    "grant_type": "client_credentials",
-                    "client_id": ")" + CLIENT_ID + R"(",
-                    "client_secret": ")" + CLIENT_SECRET + R"("
+        // Verdict for one batch or stream operation; anything but a new order passes
+        riskVerdict checkRisk(const tradeOp& op) {
+            if (!risk || !op.isOrder()) return riskVerdict::accepted;
+            return risk->check(op.params["instrument_name"].get_ref<const string&>(), op.isBuy(),
+                               opNumber(op, "amount"), opNumber(op, "price"));
+        }
+
+        // Hands an accepted order's reservation back to the risk engine with the response, which
+        // keeps the unfilled amount of a resting order working. Without the account cache the
+        // engine's positions also follow the filled amount of each order response (fills of a
+        // resting order after the response are not seen).
+        string settleOrder(const string& symbol, bool buy, double amount, string response) {
+            if (!risk) return response;
+            if (!account) {
+                static const jsonScanner fields{"result.order.filled_amount"};
+                jsonValue filled;
+                fields.scan(response, &filled);
+                double filledAmount = filled.number();
+                if (filledAmount > 0) risk->addFill(symbol, buy ? filledAmount : -filledAmount);
+            }
+            risk->followOrder(symbol, buy, amount, response);
+            return response;
+        }
+
+        // Keeps the risk engine's working orders in step with the answer to any operation
+        void followResponse(const tradeOp& op, const string& response) {
+            if (!risk) return;
+            if (op.isOrder()) {
+                settleOrder(op.params["instrument_name"].get<string>(), op.isBuy(), opNumber(op, "amount"), response);
+            } else if (op.method == "private/cancel" || op.method == "private/edit") {
+                followOrders(response);
+            } else if (op.method.rfind("private/cancel_all", 0) == 0 || op.method == "private/cancel_by_label") {
+                cancelScope scope{op.method, "", ""};
+                if (op.params.is_object() && !op.params.empty() && op.params.begin()->is_string()) {
+                    scope.field = op.params.begin().key();
+                    scope.value = op.params.begin()->get<string>();
                 }
-            })";
+                followOrders(response, scope);
+            }
+        }
+
+        // Cancel and edit responses release or resize the orders they touched in the risk
+        // engine. A mass cancel (a `scope` with a method) releases every matching order.
+        void followOrders(const string& response, const cancelScope& scope = cancelScope()) {
+            if (!risk) return;
+            static const jsonScanner fields{"result", "result.order"};
+            jsonValue values[2];
+            fields.scan(response, values);
+            if (!values[0].found()) return;
+            if (!scope.method.empty()) {
+                risk->closeOrders([&scope](const string& instrument, const string& label) {
+                    return scope.matches(instrument, label);
+                });
+            } else {
+                risk->updateOrder(values[1].found() ? values[1].raw : values[0].raw);   // private/edit : private/cancel
+            }
+        }
+
+        // With both the account cache and the risk engine, the cache feeds positions and the
+        // orders resting on the book to the engine
+        void followAccount() {
+            if (!risk || !account) return;
+            riskEngine* engine = risk.get();
+            account->setPositionListener([engine](const string& instrument, double size) {
+                engine->setPosition(instrument, size);
+            });
+            account->setOrderListener([engine](const orderRecord& order) {
+                engine->updateOrder(order.orderId, order.instrument, order.direction == "buy", order.isOpen(),
+                                    order.amount - order.filledAmount, order.label, order.updated);
+            });
+        }
+
+        // One public/get_order_book round trip
+        string fetchOrderBook(const string& symbol, long long depth) {
+            string req = "POST";
+            string url = transport.url("public/get_order_book");
+
+            // Prepare the payload for the order book request
+            const string& payload = (depth > 0) ? ORDER_BOOK_DEPTH_PAYLOAD.render(requestBuffer(), symbol, depth)
+                                                : ORDER_BOOK_PAYLOAD.render(requestBuffer(), symbol);
+
+            // Send the request to get the order book
+            return transport.send(req, DEFAULT_TIMEOUT_MS, url, payload);
+        }
+
+        // ------ Optimistic Updates ------
+        // Cancels and edits are applied to the account cache as they are sent. Returns how many
+        // open orders were marked, or -1 without the cache.
+        long long markCancelled(const cancelScope& scope, vector<orderRecord>& marked) {
+            if (!account) return -1;
+            return (long long)account->markCancelled([&scope](const orderRecord& order) {
+                return scope.matches(order.instrument, order.label);
+            }, &marked);
+        }
+
+        void markCancelled(const string& order_id, vector<orderRecord>& marked) {
+            if (account) account->markCancelled([&order_id](const orderRecord& order) { return order.orderId == order_id; }, &marked);
+        }
+
+        void markAmended(const string& order_id, double amount, double price, vector<orderRecord>& marked) {
+            if (account) account->markAmended(order_id, amount, price, &marked);
+        }
+
+        // Re-reads the account when the exchange did not do what was applied optimistically: an
+        // error, or a mass cancel that removed a different number of orders than were marked.
+        // An error also puts the `marked` orders back right away, so a request that was refused
+        // or never sent does not hide them until the reload completes.
+        string settle(string response, long long expected = -1, const cancelScope& scope = cancelScope(),
+                      const vector<orderRecord>& marked = {}) {
+            followOrders(response, scope);
+            if (!account) return response;
+            static const jsonScanner fields{"result"};
+            jsonValue result;
+            fields.scan(response, &result);
+            if (!result.found()) {
+                account->restore(marked);
+                account->refresh();
+            } else if (expected >= 0 && result.integer(-1) != expected) {
+                account->refresh();
+            }
+            return response;
+        }
 
+        // Hands `send` a callback that settles the response, and returns a future for it
+        template <typename Send>
+        future<string> settleAsync(long long expected, Send send, const cancelScope& scope = cancelScope(),
+                                   vector<orderRecord> marked = {}) {
+            auto result = make_shared<promise<string>>();
+            send([this, expected, scope, marked, result](const string& response) {
+                result->set_value(settle(response, expected, scope, marked));
+            });
+            return result->get_future();
+        }
+
+        void loadCredentials() {
+            auto it = settings.find("DERIBIT_CLIENT_ID");
+            if (it != settings.end()) clientId = it->second;
+            it = settings.find("DERIBIT_CLIENT_SECRET");
+            if (it != settings.end()) clientSecret = it->second;
+        }
+
+        // Current token, authenticating inline only when none is valid
+        shared_ptr<const authToken> liveToken() {
+            shared_ptr<const authToken> current = atomic_load(&token);
+            if (current && (long long)(time(0)) < current->expiresOn) {
+                return current;  // Token is still valid
+            }
+
+            if (current) cout << "Authorization Expired: Trying to Refresh" << endl;
+            if (!authenticate()) return nullptr;
+            return atomic_load(&token);
+        }
+
+        // Sends a public/auth request and returns the issued token, or nullptr on failure
+        shared_ptr<const authToken> requestToken(const string& payload) {
             long long startTime = (long long)(time(0));  // Get the current time
-            string response = sendRequest(req, DEFAULT_TIMEOUT_MS, url, payload);  // Send authentication request
-
-            // Parse the response JSON and extract the token information
-            auto parsed = json::parse(response);
-            if (parsed.contains("result") && parsed["result"].contains("access_token") && parsed["result"].contains("expires_in")) {
-                authToken = "Bearer " + parsed["result"]["access_token"].get<string>();  // Store the access token
-                expiresOn = startTime + (long long)(parsed["result"]["expires_in"]);      // Calculate expiration time
-                // cout << "Authorization: " << authToken << endl;  // Uncomment the line to get bearer token
-                cout << "Token expires in - " << (long long)(parsed["result"]["expires_in"]) << " seconds" << endl;
-                return true;  // Successful authentication
-            }
-            else {
+            string response = transport.send("POST", DEFAULT_TIMEOUT_MS, transport.url("public/auth"), payload);
+
+            // Extract the token information without parsing the whole response
+            static const jsonScanner fields{"result.access_token", "result.expires_in", "result.refresh_token"};
+            jsonValue values[3];
+            fields.scan(response, values);
+            if (!values[0].isString() || !values[1].found()) {
                 cerr << "Authorization Failed. Response: " << response << endl;
-                return false;  // Authentication failed
+                return nullptr;
             }
+
+            auto issued = make_shared<authToken>();
+            long long expiresIn = values[1].integer();
+            issued->bearer = "Bearer " + values[0].text();
+            issued->refreshToken = values[2].text();
+            issued->expiresOn = startTime + expiresIn;
+            // Renew three quarters of the way through the lifetime, and at least TOKEN_REFRESH_OFFSET_S early
+            issued->refreshAt = min(startTime + expiresIn * 3 / 4, issued->expiresOn - TOKEN_REFRESH_OFFSET_S);
+            return issued;
         }
 
-        // Method to verify the token and refresh if it's about to expire
-        bool verifyToken() {
-            if (((long long)(time(0)) + TOKEN_REFRESH_OFFSET_S) <= expiresOn) {
-                return true;  // Token is still valid, no need to refresh
+        // Background thread: renews the token with its refresh_token before it is due,
+        // falling back to the client credentials when the refresh token is rejected
+        void refreshLoop() {
+            unique_lock<mutex> lock(refresherMutex);
+            while (!stopping) {
+                shared_ptr<const authToken> current = atomic_load(&token);
+                auto due = chrono::system_clock::from_time_t((time_t)current->refreshAt);
+                if (refresherWake.wait_until(lock, due, [this] { return stopping; })) break;
+
+                lock.unlock();
+                shared_ptr<const authToken> issued;
+                if (!current->refreshToken.empty()) {
+                    issued = requestToken(REFRESH_PAYLOAD.render(requestBuffer(), current->refreshToken));
+                }
+                if (!issued) {
+                    issued = requestToken(AUTH_PAYLOAD.render(requestBuffer(), clientId, clientSecret));
+                }
+                lock.lock();
+
+                if (issued) {
+                    atomic_store(&token, issued);
+                } else {
+                    // Keep the current token and try again shortly
+                    auto retry = make_shared<authToken>(*current);
+                    retry->refreshAt = (long long)(time(0)) + TOKEN_RETRY_S;
+                    atomic_store(&token, shared_ptr<const authToken>(retry));
+                }
+            }
+        }
+
+    public:
+        // Reads DERIBIT_API_URL, DERIBIT_HTTP2, DERIBIT_ORDER_TRANSPORT (rest / ws),
+        // DERIBIT_ACCOUNT_CACHE (1 enables useAccountCache), RISK_LIMITS_FILE (see useRiskEngine),
+        // DERIBIT_BOOK_CACHE_MS (see useBookCache) and the credentials from the environment file, once
+        tradeManager() : tradeManager(readEnv(ENV_FIlE)) {}
+        explicit tradeManager(const transportConfig& config) : transport(config), settings(readEnv(ENV_FIlE)) {
+            loadCredentials();
+        }
+
+        // Uses the given settings (same keys as the environment file) instead of reading it
+        explicit tradeManager(const unordered_map<string, string>& env) : transport(transportConfig::fromEnv(env)), settings(env) {
+            loadCredentials();
+            auto it = env.find("DERIBIT_ORDER_TRANSPORT");
+            if (it != env.end() && it->second == "ws") {
+                useWebSocket();
+            }
+            it = env.find("DERIBIT_ACCOUNT_CACHE");
+            if (it != env.end() && it->second == "1") {
+                useAccountCache();
+            }
+            it = env.find("DERIBIT_BOOK_CACHE_MS");
+            if (it != env.end() && !it->second.empty()) {
+                try { useBookCache(stoll(it->second)); } catch (const exception&) {}
             }
+            it = env.find("RISK_LIMITS_FILE");
+            if (it != env.end() && !it->second.empty()) {
+                useRiskEngine(riskEngine::fromFile(it->second));
+            }
+        }
 
-            cout << "Authorization Expired: Trying to Refresh" << endl;
-            return authenticate();  // Refresh the token
+        ~tradeManager() {
+            {
+                lock_guard<mutex> lock(refresherMutex);
+                stopping = true;
+            }
+            refresherWake.notify_all();
+            if (refresher.joinable()) refresher.join();
+        }
+
+        // Routes placeOrder, cancelOrder, modifyOrder and cancelOrders over one authenticated WebSocket
+        // instead of REST. With LOW_LATENCY_MODE its event loop is the pinned, polling order thread.
+        // Call before sharing the manager between threads.
+        void useWebSocket() {
+            if (!wsOrders) {
+                sessionConfig config = sessionConfig::fromEnv(settings);
+                lowLatencyConfig lowLatency = lowLatencyConfig::fromEnv(settings);
+                if (lowLatency.enabled) config.dedicate(lowLatency.orderCore, lowLatency.busyPoll);
+                wsOrders = make_unique<orderEntry>(config);
+            }
+        }
+
+        // Keeps open orders, fills and positions in memory, fed by the private user channels on
+        // the order WebSocket (which this enables). Queries with `cached = true` are then
+        // answered locally once the cache has loaded. Call before sharing the manager between threads.
+        void useAccountCache() {
+            useWebSocket();
+            if (!account) {
+                account = make_unique<accountState>(wsOrders->session());
+                followAccount();
+            }
+        }
+
+        // Checks every order against `engine` before it is sent; a rejected order is answered
+        // locally with a `risk_rejected` error and never reaches the exchange. Reference prices
+        // come from the quote channels, positions from the account cache when it is enabled and
+        // otherwise from the filled amount in each order response. Call before sharing the
+        // manager between threads.
+        void useRiskEngine(unique_ptr<riskEngine> engine) {
+            risk = move(engine);
+            if (!risk) return;
+            risk->followQuotes(sessionConfig::fromEnv(settings));
+            followAccount();
+        }
+
+        // Serves getOrderBook from responses at most `ttlMs` old, keyed by (symbol, depth), and
+        // lets concurrent misses for the same key share one request. 0 only coalesces.
+        // Call before sharing the manager between threads.
+        void useBookCache(long long ttlMs) {
+            books = make_unique<snapshotCache>(ttlMs);
+        }
+
+        // Answers getOrderBook from `source` (e.g. orderBookServer::live_book) whenever it has
+        // a current book, before the cache or REST. Call before sharing the manager between threads.
+        void setBookSource(bookSource source) {
+            liveBooks = move(source);
+        }
+
+        // The order book cache, or nullptr without useBookCache()
+        const snapshotCache* bookCache() const {
+            return books.get();
+        }
+
+        // The engine in front of the order calls, or nullptr without useRiskEngine()
+        riskEngine* riskChecks() const {
+            return risk.get();
+        }
+
+        // The cache behind the cached queries, or nullptr without useAccountCache()
+        const accountState* accountCache() const {
+            return account.get();
+        }
+
+        // Method to authenticate with the client credentials and generate a new token.
+        // Blocks for one round trip; afterwards the background refresher keeps the token valid.
+        bool authenticate() {
+            // Ensure that the necessary credentials are available
+            if (clientId.empty() || clientSecret.empty()) {
+                cerr << "Please create a '" << ENV_FIlE << "' file and add 'DERIBIT_CLIENT_ID' and 'DERIBIT_CLIENT_SECRET' to it." << endl;
+                return false;
+            }
+
+            shared_ptr<const authToken> issued = requestToken(AUTH_PAYLOAD.render(requestBuffer(), clientId, clientSecret));
+            if (!issued) return false;  // Authentication failed
+
+            atomic_store(&token, issued);
+            // cout << "Authorization: " << issued->bearer << endl;  // Uncomment the line to get bearer token
+            cout << "Token expires in - " << (issued->expiresOn - (long long)(time(0))) << " seconds" << endl;
+
+            lock_guard<mutex> lock(refresherMutex);
+            if (!refresher.joinable() && !stopping) {
+                refresher = thread([this] { refreshLoop(); });
+            }
+            return true;  // Successful authentication
+        }
+
+        // Method to verify that a usable token exists. Only the very first private call
+        // (before any authenticate()) or a token the refresher failed to renew costs a round trip.
+        bool verifyToken() {
+            return liveToken() != nullptr;
         }
 
         // --- TRADING FUNCTIONS BEGIN HERE ---
 
         // A. Method to place an order (buy or sell)
         string placeOrder(int buy, string symbol, double amount, string type = "market") {
+            if (risk) {
+                riskVerdict verdict = risk->check(symbol, buy, amount);
+                if (verdict != riskVerdict::accepted) return riskRejection(verdict);
+            }
+            if (wsOrders) return settleOrder(symbol, buy, amount, awaitResponse(wsOrders->placeOrder(buy, symbol, amount, type)));
+
             string req = "POST";
             string method = (buy) ? "private/buy" : "private/sell";  // Determine whether it's a buy or sell
-            string url = "https://test.deribit.com/api/v2/" + method;
-
-            // Prepare the payload for the order request
-            string payload = R"({
-                "method": ")" + method + R"(",
-                "params": {
-                    "instrument_name": ")" + symbol + R"(",
-                    "amount": )" + to_string(amount) + R"(, 
-                    "type": ")" + type + R"(" 
-                }
-            })";
+            string url = transport.url(method);
 
-            // Verify the token and send the order request
-            if (verifyToken()) {
-                return sendRequest(req, DEFAULT_TIMEOUT_MS, url, payload, authToken);  // Send request with the authentication token
+            // Load the token first: a cold authentication encodes its own request in the same buffer
+            shared_ptr<const authToken> current = liveToken();
+            if (!current) {
+                return settleOrder(symbol, buy, amount, "Authorization Failed");  // Token verification failed
             }
-            return "Authorization Failed";  // Token verification failed
+
+            // Prepare the payload for the order request and send it with the authentication token
+            const string& payload = ORDER_PAYLOAD.render(requestBuffer(), method, symbol, amount, type);
+            return settleOrder(symbol, buy, amount, transport.send(req, DEFAULT_TIMEOUT_MS, url, payload, current->bearer));
         }
 
         // B. Method to cancel an existing order
         string cancelOrder(string order_id) {
-            string req = "POST";
-            string url = "https://test.deribit.com/api/v2/private/cancel";
+            vector<orderRecord> marked;
+            if (wsOrders) {
+                markCancelled(order_id, marked);
+                return awaitResponse(settleAsync(-1, [&](orderEntry::responseCallback done) {
+                    wsOrders->cancelOrder(order_id, move(done));
+                }, cancelScope(), move(marked)));
+            }
 
-            // Prepare the payload for the cancel order request
-            string payload = R"({
-                "method": "private/cancel",
-                "params": {
-                    "order_id": ")" + order_id + R"("
-                }
-            })";
+            string req = "POST";
+            string url = transport.url("private/cancel");
 
-            // Verify the token and send the cancel order request
-            if (verifyToken()) {
-                return sendRequest(req, DEFAULT_TIMEOUT_MS, url, payload, authToken);
+            // Verify the token and send the cancel order request; the cache is only marked once it goes out
+            shared_ptr<const authToken> current = liveToken();
+            if (!current) {
+                return "Authorization Failed";  // Token verification failed
             }
-            return "Authorization Failed";  // Token verification failed
+            markCancelled(order_id, marked);
+            const string& payload = CANCEL_PAYLOAD.render(requestBuffer(), order_id);
+            return settle(transport.send(req, DEFAULT_TIMEOUT_MS, url, payload, current->bearer), -1, cancelScope(), marked);
         }
 
-        // C. Method to modify an existing order
-        string modifyOrder(string order_id, double amount) {
+        // C. Method to modify an existing order in place with private/edit, which keeps its queue
+        // priority unless the price changes or the amount grows. A price of 0 keeps the price.
+        string modifyOrder(string order_id, double amount, double price = 0) {
+            vector<orderRecord> marked;
+            if (wsOrders) {
+                markAmended(order_id, amount, price, marked);
+                return awaitResponse(settleAsync(-1, [&](orderEntry::responseCallback done) {
+                    wsOrders->modifyOrder(order_id, amount, price, move(done));
+                }, cancelScope(), move(marked)));
+            }
+
             string req = "POST";
-            string url = "https://test.deribit.com/api/v2/private/edit";
-
-            // Prepare the payload for modifying the order
-            string payload = R"({
-                "method": "private/cancel",
-                "params": {
-                    "order_id": ")" + order_id + R"(",
-                    "amount": )" + to_string(amount) + R"(
-                }
-            })";
+            string url = transport.url("private/edit");
 
-            // Verify the token and send the modify order request
-            if (verifyToken()) {
-                return sendRequest(req, DEFAULT_TIMEOUT_MS, url, payload, authToken);
+            // Verify the token and send the modify order request; the cache is only marked once it goes out
+            shared_ptr<const authToken> current = liveToken();
+            if (!current) {
+                return "Authorization Failed";  // Token verification failed
             }
-            return "Authorization Failed";  // Token verification failed
+            markAmended(order_id, amount, price, marked);
+            const string& payload = (price > 0) ? MODIFY_PRICE_PAYLOAD.render(requestBuffer(), order_id, amount, price)
+                                                : MODIFY_PAYLOAD.render(requestBuffer(), order_id, amount);
+            return settle(transport.send(req, DEFAULT_TIMEOUT_MS, url, payload, current->bearer), -1, cancelScope(), marked);
         }
 
-        // D. Method to get the order book for a given symbol
-        string getOrderBook(string symbol, long long depth = 0) {
-            string req = "POST";
-            string url = "https://test.deribit.com/api/v2/public/get_order_book";
+        // H. Method to cancel every open order in a scope (all, one instrument, one currency or
+        // one label) with a single request, however many orders that is
+        string cancelOrders(const cancelScope& scope) {
+            vector<orderRecord> marked;
+            if (wsOrders) {
+                long long expected = markCancelled(scope, marked);
+                return awaitResponse(settleAsync(expected, [&](orderEntry::responseCallback done) {
+                    wsOrders->cancelOrders(scope, move(done));
+                }, scope, move(marked)));
+            }
 
-            // Prepare the payload for the order book request
-            string payload = R"({
-                "method": "public/get_order_book",
-                "params": {
-                    "instrument_name": ")" + symbol + R"(")" +
-                    ((depth > 0) ? R"(,"depth": )" + to_string(depth) : "") + R"(
-                }
-            })";
+            // The cache is only marked once the request goes out
+            string url = transport.url(scope.method);
+            shared_ptr<const authToken> current = liveToken();
+            if (!current) {
+                return "Authorization Failed";  // Token verification failed
+            }
+            long long expected = markCancelled(scope, marked);
+            const string& payload = scope.field.empty() ? CANCEL_ALL_PAYLOAD
+                                                        : CANCEL_SCOPE_PAYLOAD.render(requestBuffer(), scope.method, scope.field, scope.value);
+            return settle(transport.send("POST", DEFAULT_TIMEOUT_MS, url, payload, current->bearer), expected, scope, marked);
+        }
 
-            // Send the request to get the order book
-            return sendRequest(req, DEFAULT_TIMEOUT_MS, url, payload);
+        // Opens every connection the order calls use before they are needed, so the first cancel
+        // after a market move does not pay for a handshake: authenticates, fills the REST pool
+        // with keep-alive connections and, with WebSocket order entry, connects and authenticates
+        // the order socket. Returns false when authentication failed.
+        bool prewarm() {
+            bool authorized = liveToken() != nullptr;
+            size_t connections = max<size_t>(1, transport.config().poolSize);
+            vector<httpRequest> probes(connections, {"POST", DEFAULT_TIMEOUT_MS, transport.url("public/test"), TEST_PAYLOAD, ""});
+            transport.sendBatch(probes, connections);
+            if (wsOrders) {
+                // Shared with the callback, which can still run after a timed-out wait returned
+                auto open = make_shared<promise<void>>();
+                wsOrders->submit("public/test", json::object(), [open](const string&) { open->set_value(); });
+                if (open->get_future().wait_for(chrono::milliseconds(DEFAULT_TIMEOUT_MS)) != future_status::ready) return false;
+            }
+            return authorized;
+        }
+
+        // D. Method to get the order book for a given symbol
+        string getOrderBook(string symbol, long long depth = 0) {
+            if (liveBooks) {
+                string live;
+                if (liveBooks(symbol, depth, live)) return live;
+            }
+            if (books) {
+                return books->get(symbol + "|" + to_string(depth), [&] { return fetchOrderBook(symbol, depth); });
+            }
+            return fetchOrderBook(symbol, depth);
         }
 
         // E. Method to get all the positions
-        string getPositions() {
-            string req = "POST";
-            string url = "https://test.deribit.com/api/v2/private/get_positions";
+        string getPositions(bool cached = false) {
+            if (cached && account && account->ready()) return account->positionsResponse();
 
-            // Prepare the payload for the get positions request
-            string payload = R"({
-                "method": "private/get_positions",
-                "params": {}
-            })";
+            string req = "POST";
+            string url = transport.url("private/get_positions");
 
             // Verify the token and send the request for positions
-            if (verifyToken()) {
-                return sendRequest(req, DEFAULT_TIMEOUT_MS, url, payload, authToken);
+            if (shared_ptr<const authToken> current = liveToken()) {
+                return transport.send(req, DEFAULT_TIMEOUT_MS, url, POSITIONS_PAYLOAD, current->bearer);
             }
             return "Authorization Failed";  // Token verification failed
         }
+
+        // F. Method to get all open orders
+        string getOpenOrders(bool cached = false) {
+            if (cached && account && account->ready()) return account->openOrdersResponse();
+
+            string url = transport.url("private/get_open_orders");
+            if (shared_ptr<const authToken> current = liveToken()) {
+                return transport.send("POST", DEFAULT_TIMEOUT_MS, url, OPEN_ORDERS_PAYLOAD, current->bearer);
+            }
+            return "Authorization Failed";  // Token verification failed
+        }
+
+        // G. Method to get the state of one order (open, filled, cancelled, ...)
+        string getOrderState(const string& order_id, bool cached = false) {
+            if (cached && account && account->ready()) {
+                string local = account->orderStateResponse(order_id);
+                if (!local.empty()) return local;
+            }
+
+            string url = transport.url("private/get_order_state");
+            shared_ptr<const authToken> current = liveToken();
+            if (!current) {
+                return "Authorization Failed";  // Token verification failed
+            }
+            const string& payload = ORDER_STATE_PAYLOAD.render(requestBuffer(), order_id);
+            return transport.send("POST", DEFAULT_TIMEOUT_MS, url, payload, current->bearer);
+        }
+
+        // --- ASYNCHRONOUS WEBSOCKET ORDER ENTRY ---
+        // Each call returns as soon as the request is written; many can be in flight at once.
+        // Responses are matched by JSON-RPC id. Enables the WebSocket path on first use.
+
+        future<string> placeOrderAsync(int buy, const string& symbol, double amount, const string& type = "market") {
+            useWebSocket();
+            if (!risk) return wsOrders->placeOrder(buy, symbol, amount, type);
+
+            auto result = make_shared<promise<string>>();
+            riskVerdict verdict = risk->check(symbol, buy, amount);
+            if (verdict != riskVerdict::accepted) {
+                result->set_value(riskRejection(verdict));
+            } else {
+                wsOrders->placeOrder(buy, symbol, amount, type, [this, symbol, buy, amount, result](const string& response) {
+                    result->set_value(settleOrder(symbol, buy, amount, response));
+                });
+            }
+            return result->get_future();
+        }
+
+        future<string> cancelOrderAsync(const string& order_id) {
+            useWebSocket();
+            vector<orderRecord> marked;
+            markCancelled(order_id, marked);
+            return settleAsync(-1, [&](orderEntry::responseCallback done) { wsOrders->cancelOrder(order_id, move(done)); },
+                               cancelScope(), move(marked));
+        }
+
+        future<string> modifyOrderAsync(const string& order_id, double amount, double price = 0) {
+            useWebSocket();
+            vector<orderRecord> marked;
+            markAmended(order_id, amount, price, marked);
+            return settleAsync(-1, [&](orderEntry::responseCallback done) {
+                wsOrders->modifyOrder(order_id, amount, price, move(done));
+            }, cancelScope(), move(marked));
+        }
+
+        future<string> cancelOrdersAsync(const cancelScope& scope) {
+            useWebSocket();
+            vector<orderRecord> marked;
+            long long expected = markCancelled(scope, marked);
+            return settleAsync(expected, [&](orderEntry::responseCallback done) { wsOrders->cancelOrders(scope, move(done)); },
+                               scope, move(marked));
+        }
+
+        // Any operation over the WebSocket; `onResult` receives the raw response. An order the
+        // risk engine rejects is answered right away, on the caller's thread.
+        void submitAsync(const tradeOp& op, function<void(const string&)> onResult) {
+            useWebSocket();
+            if (risk && op.isOrder()) {
+                riskVerdict verdict = checkRisk(op);
+                if (verdict != riskVerdict::accepted) {
+                    if (onResult) onResult(riskRejection(verdict));
+                    return;
+                }
+            }
+            if (risk) {
+                onResult = [this, op, onResult = move(onResult)](const string& response) {
+                    followResponse(op, response);
+                    if (onResult) onResult(response);
+                };
+            }
+            wsOrders->submit(op.method, op.params, move(onResult));
+        }
+
+        // --- BATCHED ASYNCHRONOUS REST ---
+        // Runs every operation concurrently over pooled connections, at most `maxConcurrency`
+        // at a time, and reports each result through `onResult(index, response)` as it completes.
+        // The token is verified once for the whole batch. Returns all responses in submission order.
+        vector<string> submitBatch(const vector<tradeOp>& ops, size_t maxConcurrency = DEFAULT_BATCH_CONCURRENCY,
+                                   function<void(size_t, const string&)> onResult = nullptr) {
+            bool needsAuth = any_of(ops.begin(), ops.end(), [](const tradeOp& op) { return op.isPrivate(); });
+            shared_ptr<const authToken> current = needsAuth ? liveToken() : nullptr;
+            bool authorized = !needsAuth || current;
+
+            vector<httpRequest> requests;
+            vector<size_t> positions;    // Batch index of each request actually sent
+            vector<string> results(ops.size());
+            for (size_t i = 0; i < ops.size(); ++i) {
+                if (ops[i].isPrivate() && !authorized) {
+                    results[i] = "Authorization Failed";  // Token verification failed
+                    if (onResult) onResult(i, results[i]);
+                    continue;
+                }
+                riskVerdict verdict = checkRisk(ops[i]);
+                if (verdict != riskVerdict::accepted) {
+                    results[i] = riskRejection(verdict);
+                    if (onResult) onResult(i, results[i]);
+                    continue;
+                }
+                json payload = {{"method", ops[i].method}, {"params", ops[i].params}};
+                requests.push_back({"POST", DEFAULT_TIMEOUT_MS, transport.url(ops[i].method), payload.dump(),
+                                    ops[i].isPrivate() ? current->bearer : ""});
+                positions.push_back(i);
+            }
+
+            vector<string> responses = transport.sendBatch(requests, maxConcurrency,
+                [&](size_t index, const string& response) {
+                    const tradeOp& op = ops[positions[index]];
+                    followResponse(op, response);
+                    if (onResult) onResult(positions[index], response);
+                });
+            for (size_t j = 0; j < responses.size(); ++j) {
+                results[positions[j]] = move(responses[j]);
+            }
+            return results;
+        }
 };
\ No newline at end of file
@@ -0,0 +1,686 @@
+#pragma once
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <unordered_map>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <websocketpp/config/asio_client.hpp>
+#include <websocketpp/client.hpp>
+#include <nlohmann/json.hpp>
+#include "wireCodec.h"
+#include "captureLog.h"
+#include "lowLatency.h"
+
+using namespace std;
+using websocketpp::connection_hdl;
+using json = nlohmann::json;
+
+// WebSocket client type used for every upstream connection
+using client = websocketpp::client<websocketpp::config::asio_tls_client>;
+
+const string DERIBIT_WS_URL = "wss://test.deribit.com/ws/api/v2";
+const long RECONNECT_DELAY_MS = 1000;                     // Wait before reconnecting a dropped session
+const long long REAUTH_MARGIN_S = 60;                     // Renew a session's token at least this long before it expires
+
+// Frame around every outgoing call: id, method and the already encoded params
+const payloadTemplate RPC_FRAME(R"({"jsonrpc":"2.0","id":$,"method":$,"params":$})");
+const payloadTemplate CHANNEL_PARAMS(R"({"channels":[$]})");
+
+// Upstream settings, normally read from the `.env` file
+struct sessionConfig {
+    string url = DERIBIT_WS_URL;
+    string clientId;              // Optional; sessions authenticate on open when set (needed for raw channels)
+    string clientSecret;
+    size_t sessions = 1;          // Number of upstream connections symbols are spread across
+    bool offline = false;         // Never connects; messages arrive through deliver() (replay)
+    int core = -1;                // Core the event loop thread is pinned to; -1 leaves it unpinned
+    bool polling = false;         // Event loop polls with adaptiveSpin instead of blocking (low-latency mode)
+    bool busyPoll = false;        // With polling, never yield the core
+
+    // DERIBIT_WS_URL, DERIBIT_WS_SESSIONS, DERIBIT_CLIENT_ID and DERIBIT_CLIENT_SECRET
+    static sessionConfig fromEnv(const unordered_map<string, string>& env) {
+        sessionConfig config;
+        auto it = env.find("DERIBIT_WS_URL");
+        if (it != env.end() && !it->second.empty()) config.url = it->second;
+        it = env.find("DERIBIT_WS_SESSIONS");
+        if (it != env.end()) {
+            try { config.sessions = max(1, stoi(it->second)); } catch (const exception&) {}
+        }
+        it = env.find("DERIBIT_CLIENT_ID");
+        if (it != env.end()) config.clientId = it->second;
+        it = env.find("DERIBIT_CLIENT_SECRET");
+        if (it != env.end()) config.clientSecret = it->second;
+        return config;
+    }
+
+    // Low-latency mode: the event loop thread runs pinned to `eventCore` and polls
+    void dedicate(int eventCore, bool busy) {
+        core = eventCore;
+        polling = true;
+        busyPoll = busy;
+    }
+};
+
+// ======== deribitSession Class ========
+// One TLS WebSocket to Deribit shared by any number of channels. Notifications are
+// routed through a channel -> handler table and JSON-RPC responses are matched to
+// their request by id. The session connects lazily on first use, renews its token with
+// the refresh_token before it expires, re-authenticates and resubscribes every channel
+// after a reconnect, and runs all handlers on its
+// single event loop thread, which low-latency mode pins and polls instead of blocking.
+// Incoming frames are read with one jsonScanner pass; only callers that ask for a
+// parsed response pay for a JSON DOM.
+class deribitSession {
+    public:
+        using messageHandler = function<void(const json&)>;
+        using rawHandler = function<void(string_view)>;   // Receives raw JSON text valid for the call only
+
+        explicit deribitSession(const sessionConfig& config) : config_(config) {
+            client_.init_asio();
+            client_.start_perpetual();  // Keep the event loop alive across reconnects
+
+            // Configure SSL context for WSS connection
+            auto ctx = websocketpp::lib::make_shared<websocketpp::lib::asio::ssl::context>(
+                websocketpp::lib::asio::ssl::context::sslv23
+            );
+            ctx->set_options(websocketpp::lib::asio::ssl::context::default_workarounds);
+            ctx->set_verify_mode(websocketpp::lib::asio::ssl::verify_none);
+            client_.set_tls_init_handler([ctx](connection_hdl) {
+                return ctx;
+            });
+
+            client_.set_open_handler([this](connection_hdl hdl) { on_open(hdl); });
+            client_.set_message_handler([this](connection_hdl hdl, client::message_ptr msg) { on_message(hdl, msg); });
+            client_.set_close_handler([this](connection_hdl hdl) { on_close(hdl); });
+            client_.set_fail_handler([this](connection_hdl hdl) { on_close(hdl); });
+        }
+
+        ~deribitSession() {
+            stop();
+        }
+
+        deribitSession(const deribitSession&) = delete;
+        deribitSession& operator=(const deribitSession&) = delete;
+
+        // ------ Public Interface ------
+        // Routes notifications for `channel` to `handler` (receives the text of params.data).
+        // `user.*` channels are subscribed with private/subscribe and need credentials.
+        void subscribe(const string& channel, rawHandler handler) {
+            {
+                lock_guard<mutex> lock(mutex_);
+                channels_[channel] = make_shared<rawHandler>(move(handler));
+            }
+            start();
+            send_request(channel_method(channel, "subscribe"), channel_params(channel), nullptr, false);
+        }
+
+        void unsubscribe(const string& channel) {
+            {
+                lock_guard<mutex> lock(mutex_);
+                if (!channels_.erase(channel)) return;
+            }
+            send_request(channel_method(channel, "unsubscribe"), channel_params(channel), nullptr, false);
+        }
+
+        // Drops and re-adds a channel server side; Deribit answers with a fresh snapshot
+        void resubscribe(const string& channel) {
+            string params = channel_params(channel);
+            send_request(channel_method(channel, "unsubscribe"), params, nullptr, false);
+            send_request(channel_method(channel, "subscribe"), params, nullptr, false);
+        }
+
+        // Runs on the session thread every time the session opens (and authenticates), after
+        // its channels were resubscribed, and right away on the caller's thread if it is open
+        // already. Used to resync state that notifications missed while disconnected.
+        void set_ready_handler(function<void()> handler) {
+            bool open;
+            {
+                lock_guard<mutex> lock(mutex_);
+                ready_handler_ = make_shared<function<void()>>(move(handler));
+                open = open_;
+            }
+            start();
+            if (open) (*ready_handler_)();
+        }
+
+        // Runs on the session thread every time the connection closes or fails to open, after
+        // outstanding calls were answered with an error. Used to stop trusting state that is
+        // only current while notifications arrive.
+        void set_close_handler(function<void()> handler) {
+            lock_guard<mutex> lock(mutex_);
+            close_handler_ = make_shared<function<void()>>(move(handler));
+        }
+
+        // JSON-RPC call; `onResponse` receives the whole response (result or error).
+        // Calls made while disconnected are queued until the session is open.
+        void call(const string& method, const json& params, messageHandler onResponse = nullptr) {
+            rawHandler parse = nullptr;
+            if (onResponse) {
+                parse = [onResponse](string_view response) {
+                    onResponse(json::parse(response, nullptr, false));
+                };
+            }
+            request(method, params.dump(), move(parse));
+        }
+
+        // Same as call() with `params` already encoded and the raw response text passed through.
+        // With a timeout, a call still unanswered after `timeoutMs` is dropped and `onResponse`
+        // receives a "Request Timed Out" error instead.
+        void request(const string& method, string_view params, rawHandler onResponse = nullptr, long timeoutMs = 0) {
+            start();
+            send_request(method, params, move(onResponse), true, timeoutMs);
+        }
+
+        // Repeats a call every `intervalMs` on the session's event loop until stop_poll(key)
+        void poll(const string& key, const string& method, const json& params, long intervalMs, rawHandler onResponse) {
+            auto task = make_shared<pollTask>(pollTask{method, params.dump(), intervalMs, move(onResponse)});
+            {
+                lock_guard<mutex> lock(mutex_);
+                polls_[key] = task;
+            }
+            start();
+            schedule_poll(key, task, 0);
+        }
+
+        void stop_poll(const string& key) {
+            lock_guard<mutex> lock(mutex_);
+            polls_.erase(key);
+        }
+
+        // Runs `task` once on the session's event loop after `delayMs`, unless the session stops first
+        void schedule(long delayMs, function<void()> task) {
+            start();
+            client_.set_timer(delayMs, [this, task = move(task)](const websocketpp::lib::error_code& ec) {
+                if (!ec && !stopping_) task();
+            });
+        }
+
+        // Records every incoming frame to `writer`; set before the session is first used
+        void set_capture(shared_ptr<captureWriter> writer) {
+            capture_ = move(writer);
+        }
+
+        // Routes a frame as if it had arrived on the connection (used by replay)
+        void deliver(string_view payload, chrono::steady_clock::time_point received) {
+            receive_time() = received;
+            route(payload);
+        }
+
+        // Arrival time of the upstream message whose handlers are running on this thread
+        static chrono::steady_clock::time_point& receive_time() {
+            thread_local chrono::steady_clock::time_point received;
+            return received;
+        }
+
+        size_t channel_count() {
+            lock_guard<mutex> lock(mutex_);
+            return channels_.size() + polls_.size();
+        }
+
+        // Closes the connection if no channel or poll uses the session any more. It stays
+        // closed until the next subscribe, poll or call, which reopens it.
+        void suspend() {
+            lock_guard<mutex> lock(mutex_);
+            if (!channels_.empty() || !polls_.empty() || idle_) return;
+            idle_ = true;
+            backlog_.clear();
+            if (open_) {
+                closing_ = true;
+                websocketpp::lib::error_code ec;
+                client_.close(hdl_, websocketpp::close::status::normal, "Session idle", ec);
+            }
+        }
+
+        bool connected() {
+            lock_guard<mutex> lock(mutex_);
+            return connected_;
+        }
+
+        // Closes the connection and joins the event loop thread (not callable from a handler)
+        void stop() {
+            if (stopping_.exchange(true)) return;
+            client_.stop_perpetual();
+            {
+                lock_guard<mutex> lock(mutex_);
+                if (open_) {
+                    websocketpp::lib::error_code ec;
+                    client_.close(hdl_, websocketpp::close::status::normal, "Session closed", ec);
+                }
+            }
+            client_.stop();
+            if (thread_.joinable()) thread_.join();
+        }
+
+    private:
+        struct pollTask {
+            string method;
+            string params;                // Encoded once when the poll starts
+            long intervalMs;
+            rawHandler onResponse;
+        };
+
+        // ------ Core Components ------
+        sessionConfig config_;
+        client client_;
+        thread thread_;                 // Runs the client event loop
+        atomic<bool> started_{false};
+        atomic<bool> stopping_{false};
+        atomic<long long> next_id_{1};
+        shared_ptr<captureWriter> capture_;   // Optional capture of every incoming frame
+
+        mutex mutex_;                   // Protects everything below
+        connection_hdl hdl_;
+        bool open_ = false;             // Connected and, when credentials are set, authenticated
+        unsigned long long generation_ = 0;   // Bumped on every open and close; tags auth responses
+        string refresh_token_;          // From the last public/auth answer on this connection
+        bool connected_ = false;        // A connection exists or is being made
+        atomic<bool> idle_{false};      // Suspended: nothing to reconnect for until used again
+        bool closing_ = false;          // suspend() closed the connection; reopening need not wait
+        unordered_map<string, shared_ptr<rawHandler>> channels_;        // <Channel, Handler>
+        unordered_map<long long, shared_ptr<rawHandler>> pending_;      // <Request id, Handler>
+        unordered_map<string, shared_ptr<pollTask>> polls_;             // <Poll key, Task>
+        vector<string> backlog_;                                        // Calls waiting for the connection
+        shared_ptr<function<void()>> ready_handler_;
+        shared_ptr<function<void()>> close_handler_;
+
+        void start() {
+            if (config_.offline) return;
+            if (!started_.exchange(true)) {
+                {
+                    lock_guard<mutex> lock(mutex_);
+                    connected_ = true;
+                    idle_ = false;
+                }
+                connect();
+                thread_ = thread([this] { run_loop(); });
+                return;
+            }
+            if (!idle_.load(memory_order_relaxed)) return;
+
+            // Reopen a suspended session; a close still in flight reconnects from on_close
+            lock_guard<mutex> lock(mutex_);
+            if (!idle_.exchange(false) || connected_) return;
+            connected_ = true;
+            client_.set_timer(0, [this](const websocketpp::lib::error_code& ec) {
+                if (!ec && !stopping_) connect();
+            });
+        }
+
+        void run_loop() {
+            pinCurrentThread(config_.core);
+            if (!config_.polling) {
+                client_.run();
+                return;
+            }
+            adaptiveSpin spin(config_.busyPoll);
+            while (!stopping_) {
+                if (client_.poll()) spin.reset();
+                else spin.idle();
+            }
+        }
+
+        void connect() {
+            websocketpp::lib::error_code ec;
+            auto con = client_.get_connection(config_.url, ec);
+            if (ec) {
+                cerr << "Connection Error: " << ec.message() << endl;
+                return;
+            }
+            client_.connect(con);
+        }
+
+        static string channel_method(const string& channel, const string& action) {
+            return (channel.rfind("user.", 0) == 0 ? "private/" : "public/") + action;
+        }
+
+        static string channel_params(const string& channel) {
+            string params;
+            CHANNEL_PARAMS.render(params, channel);
+            return params;
+        }
+
+        // Frames are rendered into a per-thread buffer; callers may encode `params` in requestBuffer()
+        void send_request(const string& method, string_view params, rawHandler handler, bool queueIfClosed, long timeoutMs = 0) {
+            if (config_.offline) return;   // Nothing to send to during replay
+            thread_local string frame;
+            long long id = next_id_++;
+            RPC_FRAME.render(frame, id, method, rawJson{params});
+
+            lock_guard<mutex> lock(mutex_);
+            if (handler) {
+                pending_[id] = make_shared<rawHandler>(move(handler));
+                if (timeoutMs > 0) expire_request(id, timeoutMs);
+            }
+
+            if (open_) {
+                websocketpp::lib::error_code ec;
+                client_.send(hdl_, frame, websocketpp::frame::opcode::text, ec);
+                if (ec) cerr << "Send Error: " << ec.message() << endl;
+            } else if (queueIfClosed) {
+                backlog_.push_back(frame);
+            }
+            // Channel requests are not queued: on_open subscribes the whole table
+        }
+
+        // Drops call `id` if it is still unanswered after `timeoutMs` and fails it
+        void expire_request(long long id, long timeoutMs) {
+            client_.set_timer(timeoutMs, [this, id](const websocketpp::lib::error_code& ec) {
+                if (ec || stopping_) return;
+                shared_ptr<rawHandler> handler;
+                {
+                    lock_guard<mutex> lock(mutex_);
+                    auto it = pending_.find(id);
+                    if (it == pending_.end()) return;   // Answered or failed already
+                    handler = it->second;
+                    pending_.erase(it);
+                }
+                (*handler)(R"({"error":{"message":"Request Timed Out"}})");
+            });
+        }
+
+        void schedule_poll(const string& key, shared_ptr<pollTask> task, long delayMs) {
+            client_.set_timer(delayMs, [this, key, task](const websocketpp::lib::error_code& ec) {
+                if (ec || stopping_) return;
+                {
+                    lock_guard<mutex> lock(mutex_);
+                    auto it = polls_.find(key);
+                    if (it == polls_.end() || it->second != task) return;  // Stopped or replaced
+                }
+                send_request(task->method, task->params, task->onResponse, false);
+                schedule_poll(key, task, task->intervalMs);
+            });
+        }
+
+        // ------ Connection Handlers ------
+        // Requests are held in the backlog until the session is authenticated, so private
+        // calls and raw channels never race the auth response
+        void on_open(connection_hdl hdl) {
+            unique_lock<mutex> lock(mutex_);
+            hdl_ = hdl;
+            open_ = false;
+            unsigned long long generation = ++generation_;
+            if (idle_) {
+                closing_ = true;   // Suspended while connecting
+                websocketpp::lib::error_code ec;
+                client_.close(hdl, websocketpp::close::status::normal, "Session idle", ec);
+                return;
+            }
+
+            if (config_.clientId.empty()) {
+                open_ = true;
+                flush_locked();
+                lock.unlock();
+                notify_ready();
+                return;
+            }
+
+            refresh_token_.clear();
+            send_auth_locked(generation, client_credentials());
+        }
+
+        json client_credentials() const {
+            return {
+                {"grant_type", "client_credentials"},
+                {"client_id", config_.clientId},
+                {"client_secret", config_.clientSecret}
+            };
+        }
+
+        // Sends public/auth on the current connection; caller holds mutex_. The handler also runs
+        // with an error when the connection drops before the answer; by then the generation has
+        // moved on and the answer is ignored.
+        void send_auth_locked(unsigned long long generation, const json& params) {
+            long long id = next_id_++;
+            pending_[id] = make_shared<rawHandler>([this, generation](string_view response) {
+                on_auth(generation, response);
+            });
+            string auth = json{
+                {"jsonrpc", "2.0"},
+                {"id", id},
+                {"method", "public/auth"},
+                {"params", params}
+            }.dump();
+            websocketpp::lib::error_code ec;
+            client_.send(hdl_, auth, websocketpp::frame::opcode::text, ec);
+        }
+
+        // The first answer on a connection opens the session; every answer schedules the next renewal
+        void on_auth(unsigned long long generation, string_view response) {
+            static const jsonScanner fields{"result.expires_in", "result.refresh_token"};
+            jsonValue values[2];
+            fields.scan(response, values);
+            bool opened = false;
+            {
+                lock_guard<mutex> lock(mutex_);
+                if (generation != generation_) return;   // Answer for a connection that is gone
+                if (!values[0].found()) {
+                    // Nothing private works without auth; start over on a new connection
+                    cerr << "Deribit session authentication failed: " << response << endl;
+                    websocketpp::lib::error_code ec;
+                    client_.close(hdl_, websocketpp::close::status::normal, "Authentication failed", ec);
+                    return;
+                }
+                refresh_token_ = values[1].text();
+                schedule_reauth_locked(generation, values[0].integer());
+                if (!open_) {
+                    open_ = true;
+                    flush_locked();
+                    opened = true;
+                }
+            }
+            if (opened) notify_ready();
+        }
+
+        // Renews the token three quarters of the way through its lifetime, and at least
+        // REAUTH_MARGIN_S early, as the REST path does; caller holds mutex_
+        void schedule_reauth_locked(unsigned long long generation, long long expiresIn) {
+            long long delayS = max<long long>(1, min(expiresIn * 3 / 4, expiresIn - REAUTH_MARGIN_S));
+            client_.set_timer((long)(delayS * 1000), [this, generation](const websocketpp::lib::error_code& ec) {
+                if (ec || stopping_) return;
+                lock_guard<mutex> lock(mutex_);
+                if (generation != generation_ || !open_) return;   // Reconnected (and re-authenticated) since
+                json params = refresh_token_.empty() ? client_credentials()
+                                                     : json{{"grant_type", "refresh_token"}, {"refresh_token", refresh_token_}};
+                send_auth_locked(generation, params);
+            });
+        }
+
+        // Subscribes the whole channel table and sends queued calls; caller holds mutex_
+        void flush_locked() {
+            vector<string> frames;
+            json publicChannels = json::array();
+            json privateChannels = json::array();
+            for (auto& entry : channels_) {
+                bool isPrivate = channel_method(entry.first, "subscribe") == "private/subscribe";
+                (isPrivate ? privateChannels : publicChannels).push_back(entry.first);
+            }
+            for (const json* channels : {&publicChannels, &privateChannels}) {
+                if (channels->empty()) continue;
+                frames.push_back(json{
+                    {"jsonrpc", "2.0"},
+                    {"id", next_id_++},
+                    {"method", (channels == &publicChannels) ? "public/subscribe" : "private/subscribe"},
+                    {"params", {{"channels", *channels}}}
+                }.dump());
+            }
+            frames.insert(frames.end(), backlog_.begin(), backlog_.end());
+            backlog_.clear();
+
+            websocketpp::lib::error_code ec;
+            for (auto& frame : frames) {
+                client_.send(hdl_, frame, websocketpp::frame::opcode::text, ec);
+            }
+        }
+
+        void notify_ready() {
+            shared_ptr<function<void()>> handler;
+            {
+                lock_guard<mutex> lock(mutex_);
+                handler = ready_handler_;
+            }
+            if (handler) (*handler)();
+        }
+
+        void on_message(connection_hdl, client::message_ptr msg) {
+            receive_time() = chrono::steady_clock::now();
+            const string& payload = msg->get_payload();
+            if (capture_) capture_->append(payload, receive_time());
+            route(payload);
+        }
+
+        // Dispatches one frame to its channel handler or pending call
+        void route(string_view payload) {
+            static const jsonScanner fields{"method", "params.channel", "params.data", "id", "error"};
+            jsonValue values[5];
+            if (!fields.scan(payload, values)) return;
+
+            // Channel notification
+            if (values[0].view() == "subscription") {
+                thread_local string channel;   // Lookup key; keeps its capacity between messages
+                channel.assign(values[1].view());
+                shared_ptr<rawHandler> handler;
+                {
+                    lock_guard<mutex> lock(mutex_);
+                    auto it = channels_.find(channel);
+                    if (it != channels_.end()) handler = it->second;
+                }
+                if (handler && values[2].found()) (*handler)(values[2].raw);
+                return;
+            }
+
+            // Response to one of our requests
+            long long id = values[3].integer(-1);
+            if (id >= 0) {
+                shared_ptr<rawHandler> handler;
+                {
+                    lock_guard<mutex> lock(mutex_);
+                    auto it = pending_.find(id);
+                    if (it != pending_.end()) {
+                        handler = it->second;
+                        pending_.erase(it);
+                    }
+                }
+                if (handler) {
+                    (*handler)(payload);
+                } else if (values[4].found()) {
+                    cerr << "Deribit Error: " << values[4].raw << endl;
+                }
+            }
+        }
+
+        void on_close(connection_hdl) {
+            unordered_map<long long, shared_ptr<rawHandler>> orphaned;
+            shared_ptr<function<void()>> closed;
+            bool idle;
+            long delayMs = RECONNECT_DELAY_MS;
+            {
+                lock_guard<mutex> lock(mutex_);
+                open_ = false;
+                ++generation_;
+                orphaned.swap(pending_);
+                backlog_.clear();            // Their callers are failed below; a later connection must not send them
+                closed = close_handler_;
+                idle = idle_;
+                connected_ = !idle;
+                if (closing_) delayMs = 0;   // Closed on purpose and wanted again since
+                closing_ = false;
+            }
+
+            // Outstanding calls will never be answered on this connection
+            const string_view error = R"({"error":{"message":"connection closed"}})";
+            for (auto& entry : orphaned) {
+                (*entry.second)(error);
+            }
+            if (closed) (*closed)();
+
+            if (stopping_ || idle) return;
+            if (delayMs) cerr << "Deribit session closed, reconnecting" << endl;
+            client_.set_timer(delayMs, [this](const websocketpp::lib::error_code& ec) {
+                if (!ec && !stopping_) connect();
+            });
+        }
+};
+
+// ======== deribitSessionPool Class ========
+// Small fixed set of sessions; each symbol always maps to the same one. Users hold a
+// reference on a symbol's session while they need it, and a session nobody references
+// is suspended, so an idle pool keeps no upstream connection open.
+class deribitSessionPool {
+    public:
+        explicit deribitSessionPool(const sessionConfig& config) {
+            size_t count = max<size_t>(1, config.sessions);
+            for (size_t i = 0; i < count; ++i) {
+                sessions_.push_back(make_unique<deribitSession>(config));
+            }
+            references_.assign(count, 0);
+        }
+
+        deribitSession& session_for(const string& symbol) {
+            return *sessions_[index_for(symbol)];
+        }
+
+        // Takes a reference on the symbol's session
+        deribitSession& acquire(const string& symbol) {
+            size_t index = index_for(symbol);
+            lock_guard<mutex> lock(mutex_);
+            ++references_[index];
+            return *sessions_[index];
+        }
+
+        // Drops a reference; the last one out suspends the session
+        void release(const string& symbol) {
+            size_t index = index_for(symbol);
+            {
+                lock_guard<mutex> lock(mutex_);
+                if (references_[index] == 0 || --references_[index] > 0) return;
+            }
+            sessions_[index]->suspend();
+        }
+
+        size_t references() {
+            lock_guard<mutex> lock(mutex_);
+            size_t total = 0;
+            for (size_t count : references_) total += count;
+            return total;
+        }
+
+        size_t channel_count() {
+            size_t total = 0;
+            for (auto& session : sessions_) total += session->channel_count();
+            return total;
+        }
+
+        size_t connected_count() {
+            size_t total = 0;
+            for (auto& session : sessions_) total += session->connected() ? 1 : 0;
+            return total;
+        }
+
+        size_t size() const {
+            return sessions_.size();
+        }
+
+        void set_capture(const shared_ptr<captureWriter>& writer) {
+            for (auto& session : sessions_) session->set_capture(writer);
+        }
+
+        // Offers a replayed frame to every session; each routes only its own channels
+        void deliver(string_view payload, chrono::steady_clock::time_point received) {
+            for (auto& session : sessions_) session->deliver(payload, received);
+        }
+
+    private:
+        vector<unique_ptr<deribitSession>> sessions_;
+        mutex mutex_;                      // Protects references_
+        vector<size_t> references_;        // Per session
+
+        size_t index_for(const string& symbol) const {
+            return hash<string>()(symbol) % sessions_.size();
+        }
+};
@@ -0,0 +1,340 @@
+#pragma once
+#include <iostream>
+#include <unordered_map>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <functional>
+#include <curl/curl.h>
+#include "latencyStats.h"
+
+using namespace std;
+
+// Default REST endpoint used when no base URL is configured
+const string DEFAULT_BASE_URL = "https://test.deribit.com/api/v2/";
+const size_t DEFAULT_POOL_SIZE = 8;                       // Idle handles kept warm per transport
+const size_t DEFAULT_BATCH_CONCURRENCY = 32;              // Requests in flight at once in sendBatch
+
+// Callback function to capture response
+size_t WriteCallback(void* contents, size_t size, size_t nmemb, string* userp) {
+    size_t totalSize = size * nmemb;
+    userp->append((char*)contents, totalSize);
+    return totalSize;
+}
+
+// Transport settings, normally read from the `.env` file
+struct transportConfig {
+    string baseUrl = DEFAULT_BASE_URL;   // Prefix for every API method, e.g. "https://test.deribit.com/api/v2/"
+    bool http2 = false;                  // Negotiate HTTP/2 over TLS when the server supports it
+    size_t poolSize = DEFAULT_POOL_SIZE; // Maximum number of idle handles kept in the pool
+
+    // Builds the config from `.env` style key/value pairs:
+    // DERIBIT_API_URL, DERIBIT_HTTP2 (0/1) and DERIBIT_HTTP_POOL_SIZE
+    static transportConfig fromEnv(const unordered_map<string, string>& env) {
+        transportConfig config;
+        auto it = env.find("DERIBIT_API_URL");
+        if (it != env.end() && !it->second.empty()) {
+            config.baseUrl = it->second;
+            if (config.baseUrl.back() != '/') config.baseUrl += '/';
+        }
+        it = env.find("DERIBIT_HTTP2");
+        if (it != env.end()) config.http2 = (it->second == "1" || it->second == "true");
+        it = env.find("DERIBIT_HTTP_POOL_SIZE");
+        if (it != env.end()) {
+            try { config.poolSize = max(1, stoi(it->second)); } catch (const exception&) {}
+        }
+        return config;
+    }
+};
+
+// One request in a batch
+struct httpRequest {
+    string method;        // GET or POST
+    long timeout;         // Milliseconds
+    string url;
+    string payload;
+    string auth;          // Authorization header value, empty for public methods
+};
+
+// ======== httpTransport Class ========
+// Pool of warm cURL easy handles shared across threads. All handles share one
+// DNS cache, TLS session cache and connection cache, so a request only pays for
+// DNS, TCP connect and the TLS handshake when no idle keep-alive connection exists.
+class httpTransport {
+    public:
+        explicit httpTransport(const transportConfig& config = transportConfig()) : config_(config) {
+            static once_flag curlInitialized;
+            call_once(curlInitialized, [] { curl_global_init(CURL_GLOBAL_DEFAULT); });
+
+            share_ = curl_share_init();
+            curl_share_setopt(share_, CURLSHOPT_LOCKFUNC, &httpTransport::lockShare);
+            curl_share_setopt(share_, CURLSHOPT_UNLOCKFUNC, &httpTransport::unlockShare);
+            curl_share_setopt(share_, CURLSHOPT_USERDATA, this);
+            curl_share_setopt(share_, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+            curl_share_setopt(share_, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+            curl_share_setopt(share_, CURLSHOPT_SHARE, CURL_LOCK_DATA_CONNECT);
+        }
+
+        ~httpTransport() {
+            for (CURL* curl : idle_) {
+                curl_easy_cleanup(curl);
+            }
+            curl_share_cleanup(share_);
+        }
+
+        httpTransport(const httpTransport&) = delete;
+        httpTransport& operator=(const httpTransport&) = delete;
+
+        // ------ Public Interface ------
+        // Full URL for an API method, e.g. url("private/buy")
+        string url(const string& path) const {
+            return config_.baseUrl + path;
+        }
+
+        const transportConfig& config() const {
+            return config_;
+        }
+
+        // Sends an HTTP request (GET, POST) on a pooled handle
+        string send(const string& method, long timeout, const string& url, const string& payload = "", const string& auth = "") {
+            CURL* curl = acquire();
+            string response;
+            if (!curl) {
+                cerr << method << " Error - unable to create cURL handle" << endl;
+                return response;
+            }
+
+            struct curl_slist* headers = prepare(curl, method, timeout, url, payload, auth, response);
+
+            // Perform request
+            CURLcode status = curl_easy_perform(curl);
+            if (status != CURLE_OK) {
+                cerr << method << " Error - " << curl_easy_strerror(status) << endl;
+            } else {
+                recordPhases(curl, url);
+            }
+
+            finish(curl, headers);
+            release(curl, status == CURLE_OK);
+            return response;
+        }
+
+        // Runs a batch concurrently on a cURL multi handle with at most `maxConcurrency`
+        // requests in flight. Requests ride warm pooled connections (multiplexed when
+        // HTTP/2 is on), so a burst costs roughly one round trip instead of one per request.
+        // `onComplete(index, response)` fires on the calling thread as each request finishes;
+        // the returned vector holds every response in request order.
+        vector<string> sendBatch(const vector<httpRequest>& requests, size_t maxConcurrency = DEFAULT_BATCH_CONCURRENCY,
+                                 function<void(size_t, const string&)> onComplete = nullptr) {
+            vector<string> responses(requests.size());
+            vector<struct curl_slist*> headers(requests.size(), nullptr);
+            maxConcurrency = max<size_t>(1, maxConcurrency);
+
+            CURLM* multi = curl_multi_init();
+            curl_multi_setopt(multi, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+
+            size_t next = 0, running = 0;
+            auto launch = [&]() {
+                while (running < maxConcurrency && next < requests.size()) {
+                    const httpRequest& request = requests[next];
+                    CURL* curl = acquire();
+                    if (!curl) {
+                        cerr << request.method << " Error - unable to create cURL handle" << endl;
+                        if (onComplete) onComplete(next, responses[next]);
+                        ++next;
+                        continue;
+                    }
+                    headers[next] = prepare(curl, request.method, request.timeout, request.url,
+                                            request.payload, request.auth, responses[next]);
+                    curl_easy_setopt(curl, CURLOPT_PRIVATE, (void*)next);
+                    curl_multi_add_handle(multi, curl);
+                    ++next;
+                    ++running;
+                }
+            };
+
+            launch();
+            while (running > 0) {
+                int active = 0;
+                curl_multi_perform(multi, &active);
+
+                CURLMsg* msg;
+                int queued = 0;
+                while ((msg = curl_multi_info_read(multi, &queued))) {
+                    if (msg->msg != CURLMSG_DONE) continue;
+
+                    CURL* curl = msg->easy_handle;
+                    CURLcode status = msg->data.result;
+                    void* index = nullptr;
+                    curl_easy_getinfo(curl, CURLINFO_PRIVATE, &index);
+                    size_t i = (size_t)index;
+
+                    if (status != CURLE_OK) {
+                        cerr << requests[i].method << " Error - " << curl_easy_strerror(status) << endl;
+                    } else {
+                        recordPhases(curl, requests[i].url);
+                    }
+
+                    curl_multi_remove_handle(multi, curl);
+                    curl_easy_setopt(curl, CURLOPT_PRIVATE, nullptr);
+                    finish(curl, headers[i]);
+                    release(curl, status == CURLE_OK);
+                    --running;
+
+                    if (onComplete) onComplete(i, responses[i]);
+                    launch();  // Keep the window full
+                }
+
+                if (running > 0) curl_multi_poll(multi, nullptr, 0, 100, nullptr);
+            }
+
+            curl_multi_cleanup(multi);
+            return responses;
+        }
+
+    private:
+        // ------ Core Components ------
+        transportConfig config_;
+        CURLSH* share_ = nullptr;                 // Shared DNS / TLS session / connection cache
+        mutex shareLocks_[CURL_LOCK_DATA_LAST];   // One lock per shared data kind
+        mutex poolMutex_;                         // Protects idle_
+        vector<CURL*> idle_;                      // Warm handles ready for reuse
+
+        // Latency histograms for one API method
+        struct phaseHistograms {
+            latencyHistogram* dns;
+            latencyHistogram* connect;
+            latencyHistogram* tls;
+            latencyHistogram* ttfb;
+            latencyHistogram* total;
+        };
+        mutex statsMutex_;                                      // Protects phases_
+        unordered_map<string, phaseHistograms> phases_;        // <API method, Histograms>
+
+        // ------ Handle Pool ------
+        CURL* acquire() {
+            {
+                lock_guard<mutex> lock(poolMutex_);
+                if (!idle_.empty()) {
+                    CURL* curl = idle_.back();
+                    idle_.pop_back();
+                    return curl;
+                }
+            }
+            return create();
+        }
+
+        void release(CURL* curl, bool healthy) {
+            if (healthy) {
+                lock_guard<mutex> lock(poolMutex_);
+                if (idle_.size() < config_.poolSize) {
+                    idle_.push_back(curl);
+                    return;
+                }
+            }
+            curl_easy_cleanup(curl);
+        }
+
+        CURL* create() {
+            CURL* curl = curl_easy_init();
+            if (!curl) return nullptr;
+
+            curl_easy_setopt(curl, CURLOPT_SHARE, share_);
+            curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteCallback);
+            curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);          // Required for multi-threaded use
+            curl_easy_setopt(curl, CURLOPT_TCP_KEEPALIVE, 1L);     // Keep idle connections alive
+            curl_easy_setopt(curl, CURLOPT_TCP_NODELAY, 1L);
+            curl_easy_setopt(curl, CURLOPT_DNS_CACHE_TIMEOUT, 300L);
+            if (config_.http2) {
+                curl_easy_setopt(curl, CURLOPT_HTTP_VERSION, (long)CURL_HTTP_VERSION_2TLS);
+                curl_easy_setopt(curl, CURLOPT_PIPEWAIT, 1L);      // Prefer multiplexing over new connections
+            }
+            return curl;
+        }
+
+        // Per-request options; everything else was set once when the handle was created.
+        // Returns the header list, which must stay alive until finish().
+        static struct curl_slist* prepare(CURL* curl, const string& method, long timeout, const string& url,
+                                          const string& payload, const string& auth, string& response) {
+            struct curl_slist* headers = nullptr;
+            headers = curl_slist_append(headers, "Content-Type: application/json");
+            if (!auth.empty()) {
+                string authHeader = "Authorization: " + auth;
+                headers = curl_slist_append(headers, authHeader.c_str());
+            }
+
+            curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
+            curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
+            curl_easy_setopt(curl, CURLOPT_TIMEOUT_MS, timeout);
+            curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response);
+
+            // HTTP methods
+            // The handle is reused, so GET has to be restored explicitly after a POST
+            if (method == "POST") {
+                curl_easy_setopt(curl, CURLOPT_POST, 1L);
+                curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE, (long)payload.size());
+                curl_easy_setopt(curl, CURLOPT_POSTFIELDS, payload.c_str());
+            } else {
+                curl_easy_setopt(curl, CURLOPT_HTTPGET, 1L);
+            }
+            return headers;
+        }
+
+        // Detaches request-scoped pointers before the handle goes back to the pool
+        static void finish(CURL* curl, struct curl_slist* headers) {
+            curl_easy_setopt(curl, CURLOPT_HTTPHEADER, nullptr);
+            curl_easy_setopt(curl, CURLOPT_WRITEDATA, nullptr);
+            curl_slist_free_all(headers);
+        }
+
+        // ------ Latency Recording ------
+        // Records the phases of a completed transfer under "http.<method>.<phase>". cURL reports
+        // cumulative microseconds from the start of the request. DNS, connect and TLS are only
+        // recorded when a new connection was opened; a reused keep-alive connection skips them.
+        void recordPhases(CURL* curl, const string& url) {
+            curl_off_t namelookup = 0, connect = 0, appconnect = 0, starttransfer = 0, total = 0;
+            curl_easy_getinfo(curl, CURLINFO_NAMELOOKUP_TIME_T, &namelookup);
+            curl_easy_getinfo(curl, CURLINFO_CONNECT_TIME_T, &connect);
+            curl_easy_getinfo(curl, CURLINFO_APPCONNECT_TIME_T, &appconnect);
+            curl_easy_getinfo(curl, CURLINFO_STARTTRANSFER_TIME_T, &starttransfer);
+            curl_easy_getinfo(curl, CURLINFO_TOTAL_TIME_T, &total);
+
+            phaseHistograms& phases = phasesFor(url);
+            if (connect > 0) {
+                phases.dns->record((uint64_t)namelookup * 1000);
+                phases.connect->record((uint64_t)(connect - namelookup) * 1000);
+                if (appconnect > 0) phases.tls->record((uint64_t)(appconnect - connect) * 1000);
+            }
+            phases.ttfb->record((uint64_t)starttransfer * 1000);
+            phases.total->record((uint64_t)total * 1000);
+        }
+
+        phaseHistograms& phasesFor(const string& url) {
+            string method = (url.compare(0, config_.baseUrl.size(), config_.baseUrl) == 0)
+                ? url.substr(config_.baseUrl.size()) : url;
+
+            lock_guard<mutex> lock(statsMutex_);
+            auto it = phases_.find(method);
+            if (it != phases_.end()) return it->second;
+
+            latencyRegistry& stats = latencyStats();
+            string prefix = "http." + method + ".";
+            phaseHistograms phases = {
+                &stats.histogram(prefix + "dns"),
+                &stats.histogram(prefix + "connect"),
+                &stats.histogram(prefix + "tls"),
+                &stats.histogram(prefix + "ttfb"),
+                &stats.histogram(prefix + "total")
+            };
+            return phases_.emplace(method, phases).first->second;
+        }
+
+        // ------ Share Locking ------
+        static void lockShare(CURL*, curl_lock_data data, curl_lock_access, void* userptr) {
+            static_cast<httpTransport*>(userptr)->shareLocks_[data].lock();
+        }
+
+        static void unlockShare(CURL*, curl_lock_data data, void* userptr) {
+            static_cast<httpTransport*>(userptr)->shareLocks_[data].unlock();
+        }
+};
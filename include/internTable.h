@@ -0,0 +1,69 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <mutex>
+#include <cstdint>
+#include <unordered_map>
+
+using namespace std;
+
+// ======== internTable Class ========
+// Maps names to small integer ids (from 1; 0 means none). Every acquire holds a reference
+// and the id is recycled once the last one is released, so the table stays as large as
+// the set of names in use rather than every name ever seen.
+class internTable {
+    public:
+        uint32_t acquire(const string& name) {
+            lock_guard<mutex> lock(mutex_);
+            auto it = ids_.find(name);
+            if (it != ids_.end()) {
+                ++entries_[it->second - 1].references;
+                return it->second;
+            }
+            uint32_t id;
+            if (!free_.empty()) {
+                id = free_.back();
+                free_.pop_back();
+                entries_[id - 1] = {name, 1};
+            } else {
+                entries_.push_back({name, 1});
+                id = (uint32_t)entries_.size();
+            }
+            ids_.emplace(name, id);
+            return id;
+        }
+
+        void release(uint32_t id) {
+            lock_guard<mutex> lock(mutex_);
+            if (id == 0 || id > entries_.size()) return;
+            entry& slot = entries_[id - 1];
+            if (slot.references == 0 || --slot.references > 0) return;
+            ids_.erase(slot.name);
+            string().swap(slot.name);
+            free_.push_back(id);
+        }
+
+        // The id of a name in use, or 0
+        uint32_t find(const string& name) {
+            lock_guard<mutex> lock(mutex_);
+            auto it = ids_.find(name);
+            return (it != ids_.end()) ? it->second : 0;
+        }
+
+        // Names currently in use
+        size_t size() {
+            lock_guard<mutex> lock(mutex_);
+            return ids_.size();
+        }
+
+    private:
+        struct entry {
+            string name;
+            size_t references;
+        };
+
+        mutex mutex_;                              // Protects everything below
+        unordered_map<string, uint32_t> ids_;      // <Name, Id>
+        vector<entry> entries_;                    // Indexed by id - 1
+        vector<uint32_t> free_;                    // Released ids, reused first
+};
@@ -0,0 +1,163 @@
+#pragma once
+#include <iostream>
+#include <string>
+#include <map>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+#include <chrono>
+#include <cstdint>
+#include <nlohmann/json.hpp>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+using namespace std;
+using json = nlohmann::json;
+
+// Histogram resolution: 2^5 sub-buckets per power of two, about 3% relative error
+const int HISTOGRAM_SUB_BITS = 5;
+const size_t HISTOGRAM_BUCKETS = (64 - HISTOGRAM_SUB_BITS + 1) << HISTOGRAM_SUB_BITS;
+
+// ======== latencyHistogram Class ========
+// HDR-style log-linear histogram of nanosecond values. Recording is a handful of
+// relaxed atomic increments, so any number of threads can record without locks;
+// readers get an approximate but never torn view.
+class latencyHistogram {
+    public:
+        void record(uint64_t ns) {
+            buckets_[index(ns)].fetch_add(1, memory_order_relaxed);
+            count_.fetch_add(1, memory_order_relaxed);
+            sum_.fetch_add(ns, memory_order_relaxed);
+            uint64_t seen = max_.load(memory_order_relaxed);
+            while (ns > seen && !max_.compare_exchange_weak(seen, ns, memory_order_relaxed)) {}
+        }
+
+        void record(chrono::nanoseconds elapsed) {
+            record(elapsed.count() > 0 ? (uint64_t)elapsed.count() : 0);
+        }
+
+        uint64_t count() const {
+            return count_.load(memory_order_relaxed);
+        }
+
+        // Clears all samples; concurrent records may survive partially
+        void reset() {
+            for (auto& bucket : buckets_) bucket.store(0, memory_order_relaxed);
+            count_.store(0, memory_order_relaxed);
+            sum_.store(0, memory_order_relaxed);
+            max_.store(0, memory_order_relaxed);
+        }
+
+        // Smallest recorded bucket value at or above quantile `q` (0..1)
+        uint64_t percentile(double q) const {
+            uint64_t total = count();
+            if (total == 0) return 0;
+            uint64_t target = max<uint64_t>(1, (uint64_t)(q * total + 0.5));
+            uint64_t seen = 0;
+            for (size_t i = 0; i < HISTOGRAM_BUCKETS; ++i) {
+                seen += buckets_[i].load(memory_order_relaxed);
+                if (seen >= target) return min(lowest(i), max_.load(memory_order_relaxed));
+            }
+            return max_.load(memory_order_relaxed);
+        }
+
+        // Summary in microseconds
+        json summary() const {
+            uint64_t total = count();
+            return {
+                {"count", total},
+                {"mean_us", total ? sum_.load(memory_order_relaxed) / (double)total / 1000.0 : 0.0},
+                {"p50_us", percentile(0.50) / 1000.0},
+                {"p90_us", percentile(0.90) / 1000.0},
+                {"p99_us", percentile(0.99) / 1000.0},
+                {"p999_us", percentile(0.999) / 1000.0},
+                {"max_us", max_.load(memory_order_relaxed) / 1000.0}
+            };
+        }
+
+    private:
+        atomic<uint64_t> buckets_[HISTOGRAM_BUCKETS] = {};
+        atomic<uint64_t> count_{0};
+        atomic<uint64_t> sum_{0};
+        atomic<uint64_t> max_{0};
+
+        // Values below 2^SUB_BITS map to themselves; above that each power of two is
+        // split into 2^SUB_BITS equal sub-buckets
+        static size_t index(uint64_t v) {
+            const uint64_t subCount = 1ULL << HISTOGRAM_SUB_BITS;
+            if (v < subCount) return (size_t)v;
+            int shift = highestBit(v) - HISTOGRAM_SUB_BITS;
+            return (size_t)(((uint64_t)(shift + 1) << HISTOGRAM_SUB_BITS) | ((v >> shift) & (subCount - 1)));
+        }
+
+        static int highestBit(uint64_t v) {
+#if defined(_MSC_VER)
+            unsigned long msb;
+            _BitScanReverse64(&msb, v);
+            return (int)msb;
+#else
+            return 63 - __builtin_clzll(v);
+#endif
+        }
+
+        static uint64_t lowest(size_t i) {
+            const uint64_t subCount = 1ULL << HISTOGRAM_SUB_BITS;
+            if (i < subCount) return i;
+            int shift = (int)(i >> HISTOGRAM_SUB_BITS) - 1;
+            return ((i & (subCount - 1)) | subCount) << shift;
+        }
+};
+
+// ======== latencyRegistry Class ========
+// Named histograms shared by the whole process. Lookups take a shared lock; hot paths
+// should look a histogram up once and keep the reference, which stays valid forever.
+class latencyRegistry {
+    public:
+        latencyHistogram& histogram(const string& name) {
+            {
+                shared_lock<shared_mutex> lock(mutex_);
+                auto it = histograms_.find(name);
+                if (it != histograms_.end()) return *it->second;
+            }
+            unique_lock<shared_mutex> lock(mutex_);
+            auto& slot = histograms_[name];
+            if (!slot) slot = make_unique<latencyHistogram>();
+            return *slot;
+        }
+
+        // { name: summary } for every histogram that has samples
+        json snapshot() {
+            json out = json::object();
+            shared_lock<shared_mutex> lock(mutex_);
+            for (auto& entry : histograms_) {
+                if (entry.second->count()) out[entry.first] = entry.second->summary();
+            }
+            return out;
+        }
+
+        // Prints the snapshot every `intervalS` seconds on a background thread (once per process)
+        void startPeriodicDump(long intervalS) {
+            if (intervalS <= 0 || dumping_.exchange(true)) return;
+            thread([this, intervalS] {
+                while (true) {
+                    this_thread::sleep_for(chrono::seconds(intervalS));
+                    json stats = snapshot();
+                    if (!stats.empty()) cout << "Latency stats: " << stats.dump() << endl;
+                }
+            }).detach();
+        }
+
+    private:
+        shared_mutex mutex_;
+        map<string, unique_ptr<latencyHistogram>> histograms_;
+        atomic<bool> dumping_{false};
+};
+
+// Process-wide registry
+latencyRegistry& latencyStats() {
+    static latencyRegistry registry;
+    return registry;
+}
@@ -0,0 +1,166 @@
+#pragma once
+#include <string>
+#include <sstream>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <thread>
+#include <cstddef>
+#include <unordered_map>
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64)
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+const size_t CACHE_LINE_BYTES = 64;
+const size_t FANOUT_RING_CAPACITY = 4096;     // Updates in flight from the ingest thread to one fan-out thread
+const unsigned ADAPTIVE_SPIN_LIMIT = 20000;   // Idle polls spent spinning before an adaptive wait starts yielding
+
+// Thread layout of the optional low-latency mode, normally read from the `.env` file.
+// A core of -1 leaves that thread unpinned.
+struct lowLatencyConfig {
+    bool enabled = false;
+    int ingestCore = -1;              // Upstream session event loop
+    vector<int> fanoutCores = {-1};   // One fan-out thread per entry
+    int orderCore = -1;               // Order WebSocket event loop
+    bool busyPoll = false;            // Spin forever instead of yielding after ADAPTIVE_SPIN_LIMIT idle polls
+
+    // LOW_LATENCY_MODE (1 enables), LOW_LATENCY_INGEST_CORE, LOW_LATENCY_FANOUT_CORES
+    // (comma-separated), LOW_LATENCY_ORDER_CORE and LOW_LATENCY_SPIN (busy | adaptive)
+    static lowLatencyConfig fromEnv(const unordered_map<string, string>& env) {
+        lowLatencyConfig config;
+        auto it = env.find("LOW_LATENCY_MODE");
+        config.enabled = (it != env.end() && it->second == "1");
+        auto readCore = [&](const string& key, int& core) {
+            auto found = env.find(key);
+            if (found != env.end()) {
+                try { core = stoi(found->second); } catch (const exception&) {}
+            }
+        };
+        readCore("LOW_LATENCY_INGEST_CORE", config.ingestCore);
+        readCore("LOW_LATENCY_ORDER_CORE", config.orderCore);
+        it = env.find("LOW_LATENCY_FANOUT_CORES");
+        if (it != env.end() && !it->second.empty()) {
+            vector<int> cores;
+            stringstream in(it->second);
+            string item;
+            while (getline(in, item, ',')) {
+                try { cores.push_back(stoi(item)); } catch (const exception&) {}
+            }
+            if (!cores.empty()) config.fanoutCores = cores;
+        }
+        it = env.find("LOW_LATENCY_SPIN");
+        config.busyPoll = (it != env.end() && it->second == "busy");
+        return config;
+    }
+};
+
+// Pins the calling thread to one core. Returns false when `core` is negative or pinning
+// is unsupported or refused; the thread then keeps running wherever the scheduler puts it.
+inline bool pinCurrentThread(int core) {
+    if (core < 0) return false;
+#if defined(__linux__)
+    cpu_set_t cores;
+    CPU_ZERO(&cores);
+    CPU_SET(core, &cores);
+    return pthread_setaffinity_np(pthread_self(), sizeof(cores), &cores) == 0;
+#else
+    return false;
+#endif
+}
+
+// Tells the core this is a spin loop: saves power and frees the sibling hyperthread
+inline void cpuRelax() {
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64)
+    _mm_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#endif
+}
+
+// ======== adaptiveSpin Class ========
+// Idle strategy of a polling loop. Each idle poll spins; after ADAPTIVE_SPIN_LIMIT idle
+// polls in a row an adaptive wait yields the core between polls, while a busy one keeps
+// spinning. It never sleeps, so a thread picks up new work within a poll either way.
+class adaptiveSpin {
+    public:
+        explicit adaptiveSpin(bool busy) : busy_(busy) {}
+
+        void idle() {
+            if (busy_ || idlePolls_ < ADAPTIVE_SPIN_LIMIT) {
+                ++idlePolls_;
+                cpuRelax();
+            } else {
+                this_thread::yield();
+            }
+        }
+
+        // Work was found: spin again from the start
+        void reset() {
+            idlePolls_ = 0;
+        }
+
+    private:
+        bool busy_;
+        unsigned idlePolls_ = 0;
+};
+
+// ======== spscRing Class ========
+// Bounded lock-free queue between exactly one producer thread and one consumer thread.
+// Head and tail live on their own cache lines and each side keeps a cached copy of the
+// other's index, so a push or pop normally touches no shared cache line but the slot.
+template <typename T>
+class spscRing {
+    public:
+        // Capacity is rounded up to a power of two
+        explicit spscRing(size_t capacity = FANOUT_RING_CAPACITY) {
+            size_t size = 2;
+            while (size < capacity) size <<= 1;
+            slots_ = make_unique<T[]>(size);
+            mask_ = size - 1;
+        }
+
+        spscRing(const spscRing&) = delete;
+        spscRing& operator=(const spscRing&) = delete;
+
+        // Producer only. Returns false, leaving `item` untouched, when the ring is full.
+        bool tryPush(T&& item) {
+            size_t tail = tail_.load(memory_order_relaxed);
+            if (tail - headCache_ > mask_) {
+                headCache_ = head_.load(memory_order_acquire);
+                if (tail - headCache_ > mask_) return false;
+            }
+            slots_[tail & mask_] = move(item);
+            tail_.store(tail + 1, memory_order_release);
+            return true;
+        }
+
+        // Consumer only. Returns false when the ring is empty.
+        bool tryPop(T& out) {
+            size_t head = head_.load(memory_order_relaxed);
+            if (head == tailCache_) {
+                tailCache_ = tail_.load(memory_order_acquire);
+                if (head == tailCache_) return false;
+            }
+            out = move(slots_[head & mask_]);
+            slots_[head & mask_] = T();   // Release what the slot held now, not a lap later
+            head_.store(head + 1, memory_order_release);
+            return true;
+        }
+
+        size_t capacity() const { return mask_ + 1; }
+
+    private:
+        unique_ptr<T[]> slots_;
+        size_t mask_;
+
+        alignas(CACHE_LINE_BYTES) atomic<size_t> head_{0};   // Next slot to pop
+        size_t tailCache_ = 0;                               // Consumer's last view of tail_
+        alignas(CACHE_LINE_BYTES) atomic<size_t> tail_{0};   // Next slot to push
+        size_t headCache_ = 0;                               // Producer's last view of head_
+};
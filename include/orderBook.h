@@ -0,0 +1,163 @@
+#pragma once
+#include <vector>
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+
+using namespace std;
+
+const size_t DEFAULT_BOOK_CAPACITY = 1024;   // Levels reserved per side up front
+
+enum class bookSide { bid, ask };
+
+// One aggregated price level
+struct bookLevel {
+    double price;
+    double amount;
+};
+
+// Best bid/ask published for lock-free readers
+struct topOfBook {
+    double bidPrice = 0;
+    double bidAmount = 0;
+    double askPrice = 0;
+    double askAmount = 0;
+    long long changeId = 0;
+};
+
+// ======== orderBook Class ========
+// L2 book stored as two contiguous price-sorted arrays. Each side is kept with its
+// best level at the back, so the updates that dominate real feeds (near the touch)
+// shift only a handful of elements and the top-N walk touches adjacent memory.
+//
+// Threading: a single writer calls update()/clear()/setChangeId(); snapshot() and
+// depth() belong to the writer (or callers that synchronize with it). best() may be
+// called from any thread without locking: the top of book is published through a
+// sequence lock after every update that touches it.
+class orderBook {
+    public:
+        explicit orderBook(size_t capacity = DEFAULT_BOOK_CAPACITY) {
+            bids_.reserve(capacity);
+            asks_.reserve(capacity);
+        }
+
+        orderBook(const orderBook&) = delete;
+        orderBook& operator=(const orderBook&) = delete;
+
+        // ------ Writer Interface ------
+        // Sets the amount at `price`; an amount of 0 removes the level.
+        // Binary search is O(log n); the insert/erase shift is proportional to the
+        // distance from the best price. Returns the level's rank from the top (0 = best)
+        // and, through `previous`, the amount the level had before (0 if it was absent).
+        size_t update(bookSide side, double price, double amount, double* previous = nullptr) {
+            vector<bookLevel>& levels = (side == bookSide::bid) ? bids_ : asks_;
+            auto it = find(side, levels, price);
+            bool found = (it != levels.end() && it->price == price);
+            size_t rank = levels.end() - it - (found ? 1 : 0);
+            if (previous) *previous = found ? it->amount : 0;
+
+            if (amount == 0) {
+                if (found) levels.erase(it);
+            } else if (found) {
+                it->amount = amount;
+            } else {
+                levels.insert(it, bookLevel{price, amount});
+            }
+
+            if (rank == 0) publishTop();
+            return rank;
+        }
+
+        void clear() {
+            bids_.clear();
+            asks_.clear();
+            publishTop();
+        }
+
+        void setChangeId(long long changeId) {
+            changeId_ = changeId;
+            publishTop();
+        }
+
+        // Copies up to `depth` levels, best first, into caller-owned storage. No allocation.
+        size_t snapshot(bookSide side, bookLevel* out, size_t depth) const {
+            const vector<bookLevel>& levels = (side == bookSide::bid) ? bids_ : asks_;
+            size_t count = min(depth, levels.size());
+            auto it = levels.rbegin();
+            for (size_t i = 0; i < count; ++i, ++it) {
+                out[i] = *it;
+            }
+            return count;
+        }
+
+        // Level at rank `rank` from the top (0 = best); caller checks rank < depth(side)
+        const bookLevel& level(bookSide side, size_t rank) const {
+            const vector<bookLevel>& levels = (side == bookSide::bid) ? bids_ : asks_;
+            return levels[levels.size() - 1 - rank];
+        }
+
+        size_t depth(bookSide side) const {
+            return (side == bookSide::bid) ? bids_.size() : asks_.size();
+        }
+
+        long long changeId() const {
+            return changeId_;
+        }
+
+        // ------ Reader Interface ------
+        // Consistent best bid/ask, safe from any thread; never blocks the writer
+        topOfBook best() const {
+            topOfBook top;
+            uint64_t before, after;
+            do {
+                before = seq_.load(memory_order_acquire);
+                top.bidPrice = bidPrice_.load(memory_order_relaxed);
+                top.bidAmount = bidAmount_.load(memory_order_relaxed);
+                top.askPrice = askPrice_.load(memory_order_relaxed);
+                top.askAmount = askAmount_.load(memory_order_relaxed);
+                top.changeId = topChangeId_.load(memory_order_relaxed);
+                atomic_thread_fence(memory_order_acquire);
+                after = seq_.load(memory_order_relaxed);
+            } while ((before & 1) || before != after);
+            return top;
+        }
+
+    private:
+        // ------ Core Components ------
+        vector<bookLevel> bids_;   // Ascending price, best (highest) bid at the back
+        vector<bookLevel> asks_;   // Descending price, best (lowest) ask at the back
+        long long changeId_ = 0;
+
+        // Sequence-locked top of book; odd sequence means a write is in progress
+        alignas(64) atomic<uint64_t> seq_{0};
+        atomic<double> bidPrice_{0};
+        atomic<double> bidAmount_{0};
+        atomic<double> askPrice_{0};
+        atomic<double> askAmount_{0};
+        atomic<long long> topChangeId_{0};
+
+        // Position where `price` is, or would be inserted, in storage order
+        static vector<bookLevel>::iterator find(bookSide side, vector<bookLevel>& levels, double price) {
+            if (side == bookSide::bid) {
+                return lower_bound(levels.begin(), levels.end(), price,
+                    [](const bookLevel& level, double p) { return level.price < p; });
+            }
+            return lower_bound(levels.begin(), levels.end(), price,
+                [](const bookLevel& level, double p) { return level.price > p; });
+        }
+
+        void publishTop() {
+            uint64_t seq = seq_.load(memory_order_relaxed);
+            seq_.store(seq + 1, memory_order_relaxed);
+            atomic_thread_fence(memory_order_release);
+
+            bidPrice_.store(bids_.empty() ? 0 : bids_.back().price, memory_order_relaxed);
+            bidAmount_.store(bids_.empty() ? 0 : bids_.back().amount, memory_order_relaxed);
+            askPrice_.store(asks_.empty() ? 0 : asks_.back().price, memory_order_relaxed);
+            askAmount_.store(asks_.empty() ? 0 : asks_.back().amount, memory_order_relaxed);
+            topChangeId_.store(changeId_, memory_order_relaxed);
+
+            seq_.store(seq + 2, memory_order_release);
+        }
+};
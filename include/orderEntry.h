@@ -0,0 +1,143 @@
+#pragma once
+#include <string>
+#include <future>
+#include <memory>
+#include <functional>
+#include <chrono>
+#include <nlohmann/json.hpp>
+#include "deribitSession.h"
+#include "latencyStats.h"
+#include "wireCodec.h"
+
+using namespace std;
+using json = nlohmann::json;
+
+// Params of each order call, rendered into the thread's request buffer
+const payloadTemplate ORDER_PARAMS(R"({"instrument_name":$,"amount":$,"type":$})");
+const payloadTemplate CANCEL_PARAMS(R"({"order_id":$})");
+const payloadTemplate EDIT_PARAMS(R"({"order_id":$,"amount":$})");
+const payloadTemplate EDIT_PRICE_PARAMS(R"({"order_id":$,"amount":$,"price":$})");
+const payloadTemplate CANCEL_SCOPE_PARAMS(R"({$:$})");
+
+const long ORDER_RESPONSE_TIMEOUT_MS = 10000;   // Same as the REST timeout; a call unanswered by then fails
+
+// Which open orders one mass-cancel request removes
+struct cancelScope {
+    string method;   // private/cancel_all, private/cancel_all_by_instrument, ..._by_currency or private/cancel_by_label
+    string field;    // The one parameter, empty for cancel_all
+    string value;
+
+    static cancelScope all() {
+        return {"private/cancel_all", "", ""};
+    }
+    static cancelScope instrument(const string& instrument) {
+        return {"private/cancel_all_by_instrument", "instrument_name", instrument};
+    }
+    static cancelScope currency(const string& currency) {
+        return {"private/cancel_all_by_currency", "currency", currency};
+    }
+    static cancelScope label(const string& label) {
+        return {"private/cancel_by_label", "label", label};
+    }
+
+    // Best local guess of what the exchange will cancel. A currency matches any component of
+    // the instrument's first segment, so BTC_USDC-PERPETUAL counts for BTC and USDC.
+    bool matches(const string& orderInstrument, const string& orderLabel) const {
+        if (field.empty()) return true;
+        if (field == "instrument_name") return orderInstrument == value;
+        if (field == "label") return orderLabel == value;
+        string_view prefix(orderInstrument);
+        prefix = prefix.substr(0, prefix.find('-'));
+        while (!prefix.empty()) {
+            size_t split = prefix.find('_');
+            if (prefix.substr(0, split) == value) return true;
+            if (split == string_view::npos) break;
+            prefix.remove_prefix(split + 1);
+        }
+        return false;
+    }
+};
+
+// ======== orderEntry Class ========
+// Order entry over one persistent, authenticated WebSocket. Each call is a JSON-RPC
+// request tagged with its own id; the response resolves the matching future or
+// callback, so any number of orders can be in flight on the socket at once and none
+// of them pays for HTTP headers or a handshake.
+class orderEntry {
+    public:
+        using responseCallback = function<void(const string&)>;  // Receives the raw JSON-RPC response
+
+        explicit orderEntry(const sessionConfig& config) : session_(config) {}
+
+        // ------ Callback Interface ------
+        void placeOrder(int buy, const string& symbol, double amount, const string& type, responseCallback callback) {
+            string method = (buy) ? "private/buy" : "private/sell";
+            send(method, ORDER_PARAMS.render(requestBuffer(), symbol, amount, type), move(callback));
+        }
+
+        void cancelOrder(const string& order_id, responseCallback callback) {
+            send("private/cancel", CANCEL_PARAMS.render(requestBuffer(), order_id), move(callback));
+        }
+
+        // A price of 0 keeps the order's price
+        void modifyOrder(const string& order_id, double amount, double price, responseCallback callback) {
+            string_view params = (price > 0) ? EDIT_PRICE_PARAMS.render(requestBuffer(), order_id, amount, price)
+                                             : EDIT_PARAMS.render(requestBuffer(), order_id, amount);
+            send("private/edit", params, move(callback));
+        }
+
+        void cancelOrders(const cancelScope& scope, responseCallback callback) {
+            string_view params = scope.field.empty() ? string_view("{}")
+                                                     : CANCEL_SCOPE_PARAMS.render(requestBuffer(), scope.field, scope.value);
+            send(scope.method, params, move(callback));
+        }
+
+        // Any other JSON-RPC method, e.g. an operation from a batch or an order stream
+        void submit(const string& method, const json& params, responseCallback callback) {
+            send(method, params.dump(), move(callback));
+        }
+
+        // ------ Future Interface ------
+        future<string> placeOrder(int buy, const string& symbol, double amount, const string& type = "market") {
+            auto result = make_shared<promise<string>>();
+            placeOrder(buy, symbol, amount, type, [result](const string& response) { result->set_value(response); });
+            return result->get_future();
+        }
+
+        future<string> cancelOrder(const string& order_id) {
+            auto result = make_shared<promise<string>>();
+            cancelOrder(order_id, [result](const string& response) { result->set_value(response); });
+            return result->get_future();
+        }
+
+        future<string> modifyOrder(const string& order_id, double amount, double price = 0) {
+            auto result = make_shared<promise<string>>();
+            modifyOrder(order_id, amount, price, [result](const string& response) { result->set_value(response); });
+            return result->get_future();
+        }
+
+        future<string> cancelOrders(const cancelScope& scope) {
+            auto result = make_shared<promise<string>>();
+            cancelOrders(scope, [result](const string& response) { result->set_value(response); });
+            return result->get_future();
+        }
+
+        deribitSession& session() {
+            return session_;
+        }
+
+    private:
+        deribitSession session_;  // Authenticates on open; requests wait until it is ready
+
+        // Round trips are recorded under "ws.<method>.total". The response text is handed
+        // to the callback as received, without being parsed; a call that gets no answer within
+        // ORDER_RESPONSE_TIMEOUT_MS is failed with a timeout error and forgotten.
+        void send(const string& method, string_view params, responseCallback callback) {
+            latencyHistogram& roundTrip = latencyStats().histogram("ws." + method + ".total");
+            auto start = chrono::steady_clock::now();
+            session_.request(method, params, [callback, &roundTrip, start](string_view response) {
+                roundTrip.record(chrono::steady_clock::now() - start);
+                if (callback) callback(string(response));
+            }, ORDER_RESPONSE_TIMEOUT_MS);
+        }
+};
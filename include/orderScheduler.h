@@ -0,0 +1,261 @@
+#pragma once
+#include <iostream>
+#include <string>
+#include <deque>
+#include <unordered_set>
+#include <unordered_map>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include "deribitApi.h"
+#include "wireCodec.h"
+
+using namespace std;
+
+// Deribit's default sub-account credit limits. Non-matching-engine requests draw from a pool
+// of 50000 credits refilled at 10000/s, 500 per request (20/s sustained, bursts of 100).
+// Matching-engine requests (orders, edits, cancels) have their own, much smaller pool.
+const double NON_MATCHING_CREDITS = 50000;
+const double NON_MATCHING_REFILL_PER_S = 10000;
+const double NON_MATCHING_COST = 500;
+const double MATCHING_CREDITS = 20;
+const double MATCHING_REFILL_PER_S = 5;
+const double MATCHING_COST = 1;
+const long long TOO_MANY_REQUESTS = 10028;               // Deribit error code for an exhausted credit pool
+
+// One credit pool: `credits` at most, refilled continuously, `cost` per request
+struct creditLimit {
+    double credits;
+    double refillPerSecond;
+    double cost;
+
+    // Overrides from <prefix>_CREDITS, <prefix>_REFILL and <prefix>_COST
+    creditLimit withEnv(const unordered_map<string, string>& env, const string& prefix) const {
+        creditLimit limit = *this;
+        auto read = [&](const string& key, double& value) {
+            auto it = env.find(prefix + key);
+            if (it != env.end()) {
+                try { value = max(0.0, stod(it->second)); } catch (const exception&) {}
+            }
+        };
+        read("_CREDITS", limit.credits);
+        read("_REFILL", limit.refillPerSecond);
+        read("_COST", limit.cost);
+        return limit;
+    }
+};
+
+// Limits the scheduler paces against, normally the account's limits from the `.env` file
+struct schedulerConfig {
+    creditLimit matching{MATCHING_CREDITS, MATCHING_REFILL_PER_S, MATCHING_COST};
+    creditLimit nonMatching{NON_MATCHING_CREDITS, NON_MATCHING_REFILL_PER_S, NON_MATCHING_COST};
+
+    // DERIBIT_ME_CREDITS/_REFILL/_COST and DERIBIT_NON_ME_CREDITS/_REFILL/_COST
+    static schedulerConfig fromEnv(const unordered_map<string, string>& env) {
+        schedulerConfig config;
+        config.matching = config.matching.withEnv(env, "DERIBIT_ME");
+        config.nonMatching = config.nonMatching.withEnv(env, "DERIBIT_NON_ME");
+        return config;
+    }
+};
+
+// ======== creditBucket Class ========
+// Token bucket mirroring one of the exchange's credit pools. A reservation may drive the
+// balance negative; the deficit is the time until the request may be sent, so reserving
+// never blocks and requests are released in order at exactly the refill rate. One
+// request's worth of credits is always held back to absorb network jitter, so requests
+// that bunch up in transit still find credits at the exchange.
+class creditBucket {
+    public:
+        explicit creditBucket(const creditLimit& limit)
+            : limit_(limit), capacity_(max(limit.cost, limit.credits - limit.cost)), credits_(capacity_),
+              updated_(chrono::steady_clock::now()) {}
+
+        // Takes the credits for one request and returns the earliest moment it may be sent
+        chrono::steady_clock::time_point reserve(chrono::steady_clock::time_point now) {
+            lock_guard<mutex> lock(mutex_);
+            refill(now);
+            credits_ -= limit_.cost;
+            if (credits_ >= 0 || limit_.refillPerSecond <= 0) return now;
+            return now + chrono::duration_cast<chrono::steady_clock::duration>(
+                chrono::duration<double>(-credits_ / limit_.refillPerSecond));
+        }
+
+        // A reserved request was never sent: its credits go back to the pool
+        void refund(chrono::steady_clock::time_point now) {
+            lock_guard<mutex> lock(mutex_);
+            refill(now);
+            credits_ = min(capacity_, credits_ + limit_.cost);
+        }
+
+        // The exchange rejected a request: its pool is empty whatever the model says
+        void exhaust(chrono::steady_clock::time_point now) {
+            lock_guard<mutex> lock(mutex_);
+            refill(now);
+            credits_ = min(credits_, 0.0);
+        }
+
+    private:
+        creditLimit limit_;
+        double capacity_;
+        mutex mutex_;                                  // Protects the balance
+        double credits_;
+        chrono::steady_clock::time_point updated_;
+
+        void refill(chrono::steady_clock::time_point now) {
+            if (now <= updated_) return;
+            credits_ = min(capacity_, credits_ + chrono::duration<double>(now - updated_).count() * limit_.refillPerSecond);
+            updated_ = now;
+        }
+};
+
+// ======== orderScheduler Class ========
+// Sends a stream of operations over tradeManager's WebSocket order entry, each at the
+// earliest moment the account's credits allow, instead of letting a burst run into
+// `too_many_requests` and pay for retries. Matching-engine and other requests are paced
+// by separate buckets in separate lanes, so a backlog of orders never delays a query.
+// Within a lane operations are sent in submission order and many can be in flight. A
+// request the exchange still rejects (e.g. another client shares the account) empties
+// the bucket and goes back to the front of its lane; one the risk engine rejects locally
+// never reached the exchange and gives its credits back.
+class orderScheduler {
+    public:
+        using resultHandler = function<void(const string&)>;  // Receives the raw JSON-RPC response
+
+        orderScheduler(tradeManager& trader, const schedulerConfig& config = schedulerConfig())
+            : trader_(trader), matching_(config.matching), nonMatching_(config.nonMatching) {
+            trader_.useWebSocket();
+            matching_.worker = thread([this] { dispatch(matching_); });
+            nonMatching_.worker = thread([this] { dispatch(nonMatching_); });
+        }
+
+        // Call drain() first: a response still in flight would call into a destroyed scheduler
+        ~orderScheduler() {
+            for (lane* target : {&matching_, &nonMatching_}) {
+                {
+                    lock_guard<mutex> lock(target->mutex_);
+                    target->stopping = true;
+                }
+                target->wake.notify_all();
+                target->worker.join();
+            }
+        }
+
+        // Queues `op`; `onResult` runs on the order entry thread when the response arrives
+        void submit(tradeOp op, resultHandler onResult = nullptr) {
+            {
+                lock_guard<mutex> lock(outstandingMutex_);
+                ++outstanding_;
+            }
+            lane& target = laneFor(op.method);
+            {
+                lock_guard<mutex> lock(target.mutex_);
+                target.queue.push_back({move(op), move(onResult)});
+            }
+            target.wake.notify_one();
+        }
+
+        // Blocks until every submitted operation has been answered
+        void drain() {
+            unique_lock<mutex> lock(outstandingMutex_);
+            outstandingDone_.wait(lock, [this] { return outstanding_ == 0; });
+        }
+
+        // ------ Metrics ------
+        uint64_t sent() const { return sent_.load(memory_order_relaxed); }
+        uint64_t rejected() const { return rejected_.load(memory_order_relaxed); }
+
+        // Methods that go through Deribit's matching engine and draw from its credit pool
+        static bool usesMatchingEngine(const string& method) {
+            static const unordered_set<string> methods = {
+                "private/buy", "private/sell", "private/edit", "private/edit_by_label",
+                "private/cancel", "private/cancel_all", "private/cancel_all_by_currency",
+                "private/cancel_all_by_instrument", "private/cancel_all_by_kind_or_type",
+                "private/cancel_by_label", "private/close_position", "private/mass_quote",
+                "private/cancel_quotes"
+            };
+            return methods.count(method) > 0;
+        }
+
+    private:
+        struct pendingOp {
+            tradeOp op;
+            resultHandler onResult;
+        };
+
+        // One credit pool with its queue and dispatcher
+        struct lane {
+            explicit lane(const creditLimit& limit) : bucket(limit) {}
+
+            creditBucket bucket;
+            mutex mutex_;                  // Protects queue and stopping
+            condition_variable wake;
+            deque<pendingOp> queue;
+            bool stopping = false;
+            thread worker;
+        };
+
+        tradeManager& trader_;
+        lane matching_;
+        lane nonMatching_;
+
+        mutex outstandingMutex_;
+        condition_variable outstandingDone_;
+        size_t outstanding_ = 0;           // Submitted and not yet answered
+
+        atomic<uint64_t> sent_{0};
+        atomic<uint64_t> rejected_{0};     // too_many_requests responses (each is retried)
+
+        lane& laneFor(const string& method) {
+            return usesMatchingEngine(method) ? matching_ : nonMatching_;
+        }
+
+        // Takes the next operation, reserves its credits, waits out the deficit and sends it
+        void dispatch(lane& target) {
+            unique_lock<mutex> lock(target.mutex_);
+            while (true) {
+                target.wake.wait(lock, [&] { return target.stopping || !target.queue.empty(); });
+                if (target.stopping) return;
+
+                pendingOp next = move(target.queue.front());
+                target.queue.pop_front();
+                auto sendAt = target.bucket.reserve(chrono::steady_clock::now());
+                if (target.wake.wait_until(lock, sendAt, [&] { return target.stopping; })) return;
+
+                lock.unlock();
+                send(target, move(next));
+                lock.lock();
+            }
+        }
+
+        void send(lane& target, pendingOp pending) {
+            sent_.fetch_add(1, memory_order_relaxed);
+            auto shared = make_shared<pendingOp>(move(pending));
+            trader_.submitAsync(shared->op, [this, &target, shared](const string& response) {
+                static const jsonScanner fields{"error.code", "error.message"};
+                jsonValue values[2];
+                fields.scan(response, values);
+                const jsonValue& code = values[0];
+                if (values[1].view() == "risk_rejected") target.bucket.refund(chrono::steady_clock::now());
+                if (code.integer() == TOO_MANY_REQUESTS) {
+                    rejected_.fetch_add(1, memory_order_relaxed);
+                    target.bucket.exhaust(chrono::steady_clock::now());
+                    {
+                        lock_guard<mutex> lock(target.mutex_);
+                        target.queue.push_front(move(*shared));
+                    }
+                    target.wake.notify_one();
+                    return;
+                }
+
+                if (shared->onResult) shared->onResult(response);
+                lock_guard<mutex> lock(outstandingMutex_);
+                if (--outstanding_ == 0) outstandingDone_.notify_all();
+            });
+        }
+};
@@ -0,0 +1,70 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <algorithm>
+#include "clientQueue.h"
+
+using namespace std;
+
+const size_t PAYLOAD_POOL_BUFFERS = 256;          // Buffers each publishing thread recycles
+const size_t PAYLOAD_POOL_PROBES = 8;             // Buffers tried before falling back to a new allocation
+const size_t PAYLOAD_POOL_MAX_BYTES = 1 << 20;    // Larger payloads are allocated and never kept
+
+// ======== payloadPool Class ========
+// Recycles the messages behind sharedPayload. A message is free again once every queue and
+// socket that held it has let go, i.e. when the pool owns the only reference; its payload
+// is then overwritten in place, so a steady stream of updates reuses the same memory
+// instead of allocating a message and a control block per update. Every message leaves
+// the pool framed (unmasked, uncompressed), so connections write it as is without copying.
+// Owned by one publishing thread.
+class payloadPool {
+    public:
+        explicit payloadPool(size_t buffers = PAYLOAD_POOL_BUFFERS) : buffers_(max<size_t>(1, buffers)) {}
+
+        payloadPool(const payloadPool&) = delete;
+        payloadPool& operator=(const payloadPool&) = delete;
+
+        sharedPayload make(string_view text, websocketpp::frame::opcode::value opcode) {
+            if (text.size() <= PAYLOAD_POOL_MAX_BYTES) {
+                size_t probes = min(PAYLOAD_POOL_PROBES, buffers_.size());
+                for (size_t i = 0; i < probes; ++i) {
+                    sharedPayload& buffer = buffers_[cursor_];
+                    if (++cursor_ == buffers_.size()) cursor_ = 0;
+                    if (!buffer) {
+                        buffer = make_shared<outgoingMessage>(nullptr, opcode, text.size());
+                    } else if (buffer.use_count() != 1) {
+                        continue;   // Still queued or being written somewhere
+                    }
+                    // use_count() is a relaxed read; pair it with the last holder's release
+                    atomic_thread_fence(memory_order_acquire);
+                    return frame(buffer, text, opcode);
+                }
+            }
+            sharedPayload message = make_shared<outgoingMessage>(nullptr, opcode, text.size());
+            return frame(message, text, opcode);
+        }
+
+    private:
+        vector<sharedPayload> buffers_;
+        size_t cursor_ = 0;                   // Next buffer to try
+
+        // What the connection would do to an unprepared message, done once for all of them
+        static const sharedPayload& frame(const sharedPayload& message, string_view text,
+                                          websocketpp::frame::opcode::value opcode) {
+            message->get_raw_payload().assign(text.data(), text.size());
+            message->set_opcode(opcode);
+            websocketpp::frame::basic_header header(opcode, text.size(), true, false);
+            message->set_header(websocketpp::frame::prepare_header(header, websocketpp::frame::extended_header(text.size())));
+            message->set_prepared(true);
+            return message;
+        }
+};
+
+// Pool of the calling thread, for publishers that are not tied to one object
+inline payloadPool& threadPayloadPool() {
+    thread_local payloadPool pool;
+    return pool;
+}
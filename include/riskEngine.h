@@ -0,0 +1,394 @@
+#pragma once
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <deque>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <unordered_map>
+#include <nlohmann/json.hpp>
+#include "deribitSession.h"
+#include "wireCodec.h"
+
+using namespace std;
+using json = nlohmann::json;
+
+const size_t RISK_CLOSED_ORDERS_KEPT = 10000;   // Closed orders remembered so late updates cannot reopen them
+
+// Outcome of a pre-trade check
+enum class riskVerdict {
+    accepted,
+    unknownInstrument,   // No limits configured and unknown instruments are rejected
+    orderTooLarge,       // amount > max_order_amount
+    positionLimit,       // |position after a full fill of it and every working order on its side| > max_position
+    notionalLimit,       // Order notional > max_notional
+    priceCollar,         // Limit price too far through the opposite side of the book
+    noReferencePrice,    // Collar or notional limit set but no quote received yet
+    throttled            // More than max_orders_per_second (after the burst)
+};
+
+inline const char* riskReason(riskVerdict verdict) {
+    switch (verdict) {
+        case riskVerdict::accepted: return "accepted";
+        case riskVerdict::unknownInstrument: return "unknown_instrument";
+        case riskVerdict::orderTooLarge: return "max_order_amount";
+        case riskVerdict::positionLimit: return "max_position";
+        case riskVerdict::notionalLimit: return "max_notional";
+        case riskVerdict::priceCollar: return "price_collar";
+        case riskVerdict::noReferencePrice: return "no_reference_price";
+        case riskVerdict::throttled: return "max_orders_per_second";
+    }
+    return "rejected";
+}
+
+// Error response returned instead of sending a rejected order, shaped like an exchange
+// reject. Built once per verdict, so rejecting allocates nothing.
+inline const string& riskRejection(riskVerdict verdict) {
+    static const auto responses = [] {
+        vector<string> out;
+        for (int i = 0; i <= (int)riskVerdict::throttled; ++i) {
+            string response = R"({"jsonrpc":"2.0","error":{"code":-32000,"message":"risk_rejected","data":{"reason":)";
+            appendJsonString(response, riskReason((riskVerdict)i));
+            response.append("}}}");
+            out.push_back(move(response));
+        }
+        return out;
+    }();
+    return responses[(size_t)verdict];
+}
+
+// Limits for one instrument; 0 disables a limit
+struct riskLimits {
+    double maxOrderAmount = 0;
+    double maxPosition = 0;         // Absolute, in the instrument's amount units
+    double maxNotional = 0;         // Per order, in the quote currency (USD for inverse contracts)
+    bool inverse = false;           // Amount is already USD (BTC-PERPETUAL and other inverse contracts)
+    double priceCollarPct = 0;      // Limit price may cross the far touch by at most this much
+    double maxOrdersPerSecond = 0;
+    double burst = 1;               // Orders allowed back to back by the throttle
+};
+
+// ======== instrumentRisk Class ========
+// Precomputed limits and live state of one instrument, on its own cache lines. The check
+// path reads a handful of atomics and updates the working exposure and the throttle with
+// one compare-exchange each; it takes no lock and never allocates.
+//
+// Working exposure is the unfilled amount of this side's accepted orders: in flight, or
+// resting on the book. An accepted order reserves its amount; the reservation is given
+// back as the order fills, is cancelled or is rejected, so a burst of orders cannot pass
+// max_position together before any of them fills.
+class alignas(64) instrumentRisk {
+    public:
+        explicit instrumentRisk(const riskLimits& limits)
+            : limits_(limits),
+              collar_(limits.priceCollarPct / 100),
+              intervalNs_(limits.maxOrdersPerSecond > 0 ? (long long)(1e9 / limits.maxOrdersPerSecond) : 0),
+              toleranceNs_((long long)((max(1.0, limits.burst) - 1) * intervalNs_)) {}
+
+        // `price` 0 means a market order. `nowNs` is any monotonic clock in nanoseconds.
+        riskVerdict check(bool buy, double amount, double price, long long nowNs) {
+            if (!(amount > 0)) return riskVerdict::orderTooLarge;
+            if (limits_.maxOrderAmount > 0 && amount > limits_.maxOrderAmount) return riskVerdict::orderTooLarge;
+
+            if (limits_.maxNotional > 0 || collar_ > 0) {
+                double farTouch = (buy ? ask_ : bid_).load(memory_order_relaxed);
+                if (farTouch <= 0) return riskVerdict::noReferencePrice;
+                if (collar_ > 0 && price > 0) {
+                    if (buy ? price > farTouch * (1 + collar_) : price < farTouch * (1 - collar_)) {
+                        return riskVerdict::priceCollar;
+                    }
+                }
+                if (limits_.maxNotional > 0) {
+                    double notional = limits_.inverse ? amount : amount * (price > 0 ? price : farTouch);
+                    if (notional > limits_.maxNotional) return riskVerdict::notionalLimit;
+                }
+            }
+
+            // Reserved last, so only a throttled order has to give its reservation back
+            if (limits_.maxPosition > 0 && !reserve(buy, amount)) return riskVerdict::positionLimit;
+            if (!throttle(nowNs)) {
+                release(buy, amount);
+                return riskVerdict::throttled;
+            }
+            return riskVerdict::accepted;
+        }
+
+        // ------ State Updates (any thread) ------
+        void setQuote(double bid, double ask) {
+            bid_.store(bid, memory_order_relaxed);
+            ask_.store(ask, memory_order_relaxed);
+        }
+
+        void setPosition(double size) {
+            position_.store(size, memory_order_relaxed);
+        }
+
+        void addFill(double signedAmount) {
+            double current = position_.load(memory_order_relaxed);
+            while (!position_.compare_exchange_weak(current, current + signedAmount, memory_order_relaxed)) {}
+        }
+
+        // Adds to a side's working exposure without a limit check, for an order the exchange
+        // already holds. Working exposure is only kept while max_position is set.
+        void hold(bool buy, double amount) {
+            if (limits_.maxPosition <= 0 || !(amount > 0)) return;
+            atomic<double>& working = buy ? workingBuy_ : workingSell_;
+            double current = working.load(memory_order_relaxed);
+            while (!working.compare_exchange_weak(current, current + amount, memory_order_relaxed)) {}
+        }
+
+        // Gives back working exposure of an order that filled, closed or never reached the book
+        void release(bool buy, double amount) {
+            if (limits_.maxPosition <= 0 || !(amount > 0)) return;
+            atomic<double>& working = buy ? workingBuy_ : workingSell_;
+            double current = working.load(memory_order_relaxed);
+            while (!working.compare_exchange_weak(current, max(0.0, current - amount), memory_order_relaxed)) {}
+        }
+
+        double position() const { return position_.load(memory_order_relaxed); }
+        double working(bool buy) const { return (buy ? workingBuy_ : workingSell_).load(memory_order_relaxed); }
+        const riskLimits& limits() const { return limits_; }
+
+    private:
+        riskLimits limits_;
+        double collar_;                    // priceCollarPct as a fraction
+        long long intervalNs_;             // Emission interval of the throttle
+        long long toleranceNs_;            // How far ahead of schedule a burst may run
+
+        alignas(64) atomic<double> position_{0};
+        atomic<double> workingBuy_{0};     // Unfilled amount of accepted buy orders
+        atomic<double> workingSell_{0};    // Unfilled amount of accepted sell orders
+        atomic<double> bid_{0};
+        atomic<double> ask_{0};
+        atomic<long long> throttleTat_{0}; // Theoretical arrival time of the next order
+
+        // Reserves `amount` on its side if a full fill of it and of every working order on that
+        // side keeps the position within max_position
+        bool reserve(bool buy, double amount) {
+            atomic<double>& working = buy ? workingBuy_ : workingSell_;
+            double position = position_.load(memory_order_relaxed);
+            double current = working.load(memory_order_relaxed);
+            while (true) {
+                double after = buy ? position + current + amount : position - current - amount;
+                if (fabs(after) > limits_.maxPosition) return false;
+                if (working.compare_exchange_weak(current, current + amount, memory_order_relaxed)) return true;
+            }
+        }
+
+        // Generic cell rate algorithm: one compare-exchange, no timer, no lock
+        bool throttle(long long nowNs) {
+            if (intervalNs_ == 0) return true;
+            long long tat = throttleTat_.load(memory_order_relaxed);
+            while (true) {
+                long long start = max(tat, nowNs);
+                if (start - nowNs > toleranceNs_) return false;
+                if (throttleTat_.compare_exchange_weak(tat, start + intervalNs_, memory_order_relaxed)) return true;
+            }
+        }
+};
+
+// ======== riskEngine Class ========
+// Pre-trade checks run inline before an order is sent, so a bad order is rejected locally
+// instead of costing a round trip and an exchange reject. Instruments are registered up
+// front; the table is never modified afterwards, so lookups need no lock. Quotes come
+// from each instrument's `quote.{instrument}` channel, positions from the account cache
+// or from fills reported by the caller. Orders the exchange holds are followed by id, off
+// the check path and under a lock, so their unfilled amount stays reserved until they close.
+class riskEngine {
+    public:
+        riskEngine() = default;
+
+        // Reads limits from a JSON file:
+        // {"reject_unknown": true, "instruments": {"BTC-PERPETUAL": {"max_order_amount": 1000, ...}}}
+        static unique_ptr<riskEngine> fromFile(const string& path) {
+            ifstream file(path);
+            if (!file) {
+                cerr << "Error: Unable to open risk limits file " << path << endl;
+                return nullptr;
+            }
+            json config = json::parse(file, nullptr, false);
+            if (config.is_discarded()) {
+                cerr << "Error: Invalid JSON in risk limits file " << path << endl;
+                return nullptr;
+            }
+
+            auto engine = make_unique<riskEngine>();
+            engine->rejectUnknown_ = config.value("reject_unknown", true);
+            for (auto& entry : config.value("instruments", json::object()).items()) {
+                const json& spec = entry.value();
+                riskLimits limits;
+                limits.maxOrderAmount = spec.value("max_order_amount", 0.0);
+                limits.maxPosition = spec.value("max_position", 0.0);
+                limits.maxNotional = spec.value("max_notional", 0.0);
+                limits.inverse = spec.value("inverse", false);
+                limits.priceCollarPct = spec.value("price_collar_pct", 0.0);
+                limits.maxOrdersPerSecond = spec.value("max_orders_per_second", 0.0);
+                limits.burst = spec.value("burst", 1.0);
+                engine->addInstrument(entry.key(), limits);
+            }
+            return engine;
+        }
+
+        // Setup only: call before the engine is shared between threads
+        void addInstrument(const string& instrument, const riskLimits& limits) {
+            instruments_[instrument] = make_unique<instrumentRisk>(limits);
+        }
+
+        void setRejectUnknown(bool reject) {
+            rejectUnknown_ = reject;
+        }
+
+        // Subscribes to the best bid/ask of every instrument whose limits need a reference price.
+        // Setup only, like addInstrument.
+        void followQuotes(const sessionConfig& config) {
+            for (auto& entry : instruments_) {
+                const riskLimits& limits = entry.second->limits();
+                if (limits.maxNotional <= 0 && limits.priceCollarPct <= 0) continue;
+                if (!quotes_) {
+                    sessionConfig publicConfig = config;
+                    publicConfig.clientId.clear();   // Public channel; no need to authenticate
+                    publicConfig.clientSecret.clear();
+                    quotes_ = make_unique<deribitSession>(publicConfig);
+                }
+                instrumentRisk* state = entry.second.get();
+                quotes_->subscribe("quote." + entry.first, [state](string_view data) {
+                    static const jsonScanner fields{"best_bid_price", "best_ask_price"};
+                    jsonValue values[2];
+                    fields.scan(data, values);
+                    state->setQuote(values[0].number(), values[1].number());
+                });
+            }
+        }
+
+        // The instrument's state, or nullptr when it has no limits
+        instrumentRisk* find(const string& instrument) const {
+            auto it = instruments_.find(instrument);
+            return (it != instruments_.end()) ? it->second.get() : nullptr;
+        }
+
+        // Runs every check for one order; `price` 0 means a market order. An accepted order
+        // reserves its amount, which the caller hands back through followOrder() once the
+        // exchange answered, or release() if the order was never sent.
+        riskVerdict check(const string& instrument, bool buy, double amount, double price = 0) {
+            instrumentRisk* state = find(instrument);
+            if (!state) return rejectUnknown_ ? riskVerdict::unknownInstrument : riskVerdict::accepted;
+            long long nowNs = chrono::duration_cast<chrono::nanoseconds>(
+                chrono::steady_clock::now().time_since_epoch()).count();
+            return state->check(buy, amount, price, nowNs);
+        }
+
+        void release(const string& instrument, bool buy, double amount) {
+            if (instrumentRisk* state = find(instrument)) state->release(buy, amount);
+        }
+
+        // ------ Working Orders ------
+        // Settles an accepted order's reservation with the exchange's answer: the `reserved`
+        // amount is released and, while the order in the response rests on the book, its
+        // unfilled amount is held again under its id
+        void followOrder(const string& instrument, bool buy, double reserved, string_view response) {
+            static const jsonScanner fields{"result.order"};
+            jsonValue order;
+            fields.scan(response, &order);
+            release(instrument, buy, reserved);
+            if (order.found()) updateOrder(order.raw);
+        }
+
+        // Applies a Deribit order object, from a response or a user.orders notification
+        void updateOrder(string_view order) {
+            static const jsonScanner fields{"order_id", "instrument_name", "direction", "order_state", "amount",
+                                            "filled_amount", "label", "last_update_timestamp"};
+            jsonValue values[8];
+            fields.scan(order, values);
+            if (!values[0].isString()) return;
+            string_view state = values[3].view();
+            updateOrder(values[0].text(), values[1].text(), values[2].view() == "buy",
+                        state == "open" || state == "untriggered", values[4].number() - values[5].number(),
+                        values[6].text(), values[7].integer());
+        }
+
+        // Holds `remaining` for an open order and releases whatever it held once it closes.
+        // Updates older than the last one applied, and any update after a close, are ignored.
+        void updateOrder(const string& orderId, const string& instrument, bool buy, bool open, double remaining,
+                         const string& label, long long updated) {
+            instrumentRisk* state = find(instrument);
+            if (!state || state->limits().maxPosition <= 0) return;
+            lock_guard<mutex> lock(ordersMutex_);
+            auto it = orders_.find(orderId);
+            if (it == orders_.end()) {
+                // Also remembered when it closed right away, so a late "open" cannot revive it
+                it = orders_.emplace(orderId, workingOrder{state, instrument, buy, 0, label, 0, false}).first;
+            }
+            workingOrder& tracked = it->second;
+            if (tracked.closed || updated < tracked.updated) return;
+            tracked.updated = updated;
+            double held = open ? max(0.0, remaining) : 0;
+            if (held > tracked.remaining) state->hold(buy, held - tracked.remaining);
+            else state->release(buy, tracked.remaining - held);
+            tracked.remaining = held;
+            if (!open) {
+                closeLocked(tracked, orderId);
+                trimClosedLocked();
+            }
+        }
+
+        // Releases every followed order `matches(instrument, label)` accepts, after a mass cancel
+        template <typename Predicate>
+        void closeOrders(Predicate matches) {
+            lock_guard<mutex> lock(ordersMutex_);
+            for (auto it = orders_.begin(); it != orders_.end(); ++it) {
+                workingOrder& tracked = it->second;
+                if (tracked.closed || !matches(tracked.instrument, tracked.label)) continue;
+                tracked.state->release(tracked.buy, tracked.remaining);
+                tracked.remaining = 0;
+                closeLocked(tracked, it->first);
+            }
+            trimClosedLocked();
+        }
+
+        void setPosition(const string& instrument, double size) {
+            if (instrumentRisk* state = find(instrument)) state->setPosition(size);
+        }
+
+        void addFill(const string& instrument, double signedAmount) {
+            if (instrumentRisk* state = find(instrument)) state->addFill(signedAmount);
+        }
+
+        void setQuote(const string& instrument, double bid, double ask) {
+            if (instrumentRisk* state = find(instrument)) state->setQuote(bid, ask);
+        }
+
+    private:
+        struct workingOrder {
+            instrumentRisk* state;
+            string instrument;
+            bool buy;
+            double remaining;          // Held on the state's working exposure
+            string label;
+            long long updated;         // last_update_timestamp of the update last applied
+            bool closed;
+        };
+
+        unordered_map<string, unique_ptr<instrumentRisk>> instruments_;   // Fixed after setup
+        bool rejectUnknown_ = true;
+        unique_ptr<deribitSession> quotes_;   // Quote subscriptions, when any limit needs a price
+
+        mutex ordersMutex_;                               // Protects everything below
+        unordered_map<string, workingOrder> orders_;      // <Order id, Order>
+        deque<string> closed_;                            // Closed order ids, oldest first
+
+        void closeLocked(workingOrder& tracked, const string& orderId) {
+            tracked.closed = true;
+            closed_.push_back(orderId);
+        }
+
+        void trimClosedLocked() {
+            while (closed_.size() > RISK_CLOSED_ORDERS_KEPT) {
+                orders_.erase(closed_.front());
+                closed_.pop_front();
+            }
+        }
+};
@@ -0,0 +1,125 @@
+#pragma once
+#include <string>
+#include <memory>
+#include <future>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <unordered_map>
+#include "wireCodec.h"
+
+using namespace std;
+
+// Supplies a `public/get_order_book`-shaped response from a live local book. Returns false
+// when it has no current book for the symbol.
+using bookSource = function<bool(const string& symbol, long long depth, string& out)>;
+
+// ======== snapshotCache Class ========
+// Responses kept for a short staleness budget and fetched single-flight: the first caller
+// to miss a key fetches it, and every caller that misses the same key meanwhile waits for
+// that one response instead of sending its own request. Only successful responses (with a
+// `result`) are kept; a failure, or an exception from the fetch, is shared with its waiters
+// and then forgotten, and expired responses are swept out on later misses.
+// A budget of 0 keeps nothing and only coalesces concurrent misses.
+class snapshotCache {
+    public:
+        using fetcher = function<string()>;
+
+        explicit snapshotCache(long long ttlMs) : ttl_(chrono::milliseconds(max(0LL, ttlMs))) {}
+
+        snapshotCache(const snapshotCache&) = delete;
+        snapshotCache& operator=(const snapshotCache&) = delete;
+
+        string get(const string& key, const fetcher& fetch) {
+            auto now = chrono::steady_clock::now();
+            unique_lock<mutex> lock(mutex_);
+            entry& slot = entries_[key];
+            if (slot.value && now - slot.fetchedAt <= ttl_) {
+                hits_.fetch_add(1, memory_order_relaxed);
+                return *slot.value;
+            }
+            if (slot.inflight.valid()) {
+                shared_future<shared_ptr<const string>> pending = slot.inflight;
+                lock.unlock();
+                coalesced_.fetch_add(1, memory_order_relaxed);
+                return *pending.get();
+            }
+
+            promise<shared_ptr<const string>> done;
+            slot.inflight = done.get_future().share();
+            sweep(now);
+            lock.unlock();
+
+            // The response is at least as fresh as the moment the request went out
+            fetched_.fetch_add(1, memory_order_relaxed);
+            shared_ptr<const string> response;
+            bool keep = false;
+            try {
+                response = make_shared<const string>(fetch());
+                static const jsonScanner fields{"result"};
+                jsonValue result;
+                fields.scan(*response, &result);
+                keep = ttl_.count() > 0 && result.found();
+            } catch (...) {
+                // Waiters get the same exception rather than a broken promise, and the next miss fetches again
+                lock.lock();
+                settle(key, nullptr, now);
+                lock.unlock();
+                done.set_exception(current_exception());
+                throw;
+            }
+
+            lock.lock();
+            settle(key, keep ? response : nullptr, now);
+            lock.unlock();
+            done.set_value(response);
+            return *response;
+        }
+
+        // ------ Metrics ------
+        uint64_t hits() const { return hits_.load(memory_order_relaxed); }
+        uint64_t coalesced() const { return coalesced_.load(memory_order_relaxed); }
+        uint64_t fetched() const { return fetched_.load(memory_order_relaxed); }
+
+    private:
+        struct entry {
+            shared_ptr<const string> value;                        // Last kept response
+            chrono::steady_clock::time_point fetchedAt;
+            shared_future<shared_ptr<const string>> inflight;      // Valid while a fetch runs
+        };
+
+        // Ends the fetch for `key`: keeps `value` when given, otherwise forgets the key unless an
+        // older response is still fresh. Call with mutex_ held.
+        void settle(const string& key, shared_ptr<const string> value, chrono::steady_clock::time_point fetchedAt) {
+            auto it = entries_.find(key);
+            if (it == entries_.end()) return;
+            it->second.inflight = {};
+            if (value) {
+                it->second.value = move(value);
+                it->second.fetchedAt = fetchedAt;
+            } else if (!it->second.value || fetchedAt - it->second.fetchedAt > ttl_) {
+                entries_.erase(it);
+            }
+        }
+
+        // Drops the entries whose response is past the budget and that no fetch is filling, at
+        // most once per budget so a miss stays cheap. Call with mutex_ held.
+        void sweep(chrono::steady_clock::time_point now) {
+            if (now - lastSweep_ <= ttl_) return;
+            lastSweep_ = now;
+            for (auto it = entries_.begin(); it != entries_.end();) {
+                bool stale = !it->second.value || now - it->second.fetchedAt > ttl_;
+                if (stale && !it->second.inflight.valid()) it = entries_.erase(it);
+                else ++it;
+            }
+        }
+
+        chrono::steady_clock::duration ttl_;
+        mutex mutex_;                                              // Protects entries_
+        unordered_map<string, entry> entries_;                     // <Key, Entry>, only fresh or in-flight ones past a sweep
+        chrono::steady_clock::time_point lastSweep_;
+        atomic<uint64_t> hits_{0};
+        atomic<uint64_t> coalesced_{0};                            // Misses that joined another caller's fetch
+        atomic<uint64_t> fetched_{0};
+};
@@ -0,0 +1,168 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <array>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+#include <websocketpp/common/connection_hdl.hpp>
+#include "clientQueue.h"
+
+using namespace std;
+using websocketpp::connection_hdl;
+
+const size_t SUBSCRIPTION_SHARDS = 16;    // Independent write locks across topics
+
+// One downstream connection watching a topic, with the queue updates are pushed to
+struct subscriber {
+    connection_hdl hdl;
+    shared_ptr<clientQueue> queue;
+    size_t lane = 0;   // Fan-out thread that serves the connection in low-latency mode
+    bool shareFrames = false;   // Written the publisher's prepared frames instead of framing its own
+};
+
+using subscriberList = vector<subscriber>;
+using laneLists = vector<subscriberList>;   // Subscribers split by subscriber::lane
+
+// ======== topic Class ========
+// Subscribers of one topic. The list is an immutable snapshot: publishers read it with a
+// single atomic load and never lock, while subscribe/unsubscribe (serialized by the
+// registry shard) publish a modified copy. The same subscribers are also published split
+// by lane, so each low-latency fan-out thread walks only its own connections. Every topic
+// gets an id that is never reused, so an update still in flight for a dropped topic can
+// never be taken for a newer one. `key` is the interned group key it is registered under,
+// which is recycled once the topic is gone.
+class topic {
+    public:
+        topic(const string& name, uint32_t key, uint64_t id) : name_(name), key_(key), id_(id) {}
+
+        shared_ptr<const subscriberList> subscribers() const {
+            return atomic_load(&subscribers_);
+        }
+
+        // Index = lane; empty when the topic has no subscribers
+        shared_ptr<const laneLists> lanes() const {
+            return atomic_load(&lanes_);
+        }
+
+        const string& name() const {
+            return name_;
+        }
+
+        uint32_t key() const {
+            return key_;
+        }
+
+        uint64_t id() const {
+            return id_;
+        }
+
+    private:
+        friend class subscriptionRegistry;
+
+        string name_;
+        uint32_t key_;
+        uint64_t id_;
+        shared_ptr<const subscriberList> subscribers_ = make_shared<const subscriberList>();
+        shared_ptr<const laneLists> lanes_ = make_shared<const laneLists>();
+
+        void publish(shared_ptr<const subscriberList> list) {
+            auto split = make_shared<laneLists>();
+            for (auto& entry : *list) {
+                if (entry.lane >= split->size()) split->resize(entry.lane + 1);
+                (*split)[entry.lane].push_back(entry);
+            }
+            atomic_store(&lanes_, shared_ptr<const laneLists>(move(split)));
+            atomic_store(&subscribers_, move(list));
+        }
+};
+
+// ======== subscriptionRegistry Class ========
+// Topics by interned key (see internTable), split across shards by key so writers on
+// different topics never contend. The caller holds a reference on the key while it is
+// subscribed. Publishers hold a shared_ptr<topic> and do not touch the registry at all.
+class subscriptionRegistry {
+    public:
+        using topicHandler = function<void(const shared_ptr<topic>&)>;
+
+        // Adds `entry` to the topic, creating it under `name` if needed. `onFirst` runs under
+        // the shard lock when the topic gains its first subscriber. Returns false if already subscribed.
+        bool add(uint32_t key, const string& name, const subscriber& entry, const topicHandler& onFirst = nullptr) {
+            shard& target = shard_for(key);
+            lock_guard<mutex> lock(target.mutex_);
+            shared_ptr<topic>& slot = target.topics[key];
+            if (!slot) slot = make_shared<topic>(name, key, next_id_.fetch_add(1, memory_order_relaxed));
+
+            shared_ptr<const subscriberList> current = slot->subscribers();
+            for (auto& existing : *current) {
+                if (same(existing.hdl, entry.hdl)) return false;
+            }
+            auto next = make_shared<subscriberList>(*current);
+            next->push_back(entry);
+            slot->publish(move(next));
+
+            if (current->empty() && onFirst) onFirst(slot);
+            return true;
+        }
+
+        // Removes `hdl` from the topic. `onLast` runs under the shard lock when the last
+        // subscriber leaves, after which the topic is dropped. Returns false if not subscribed.
+        bool remove(uint32_t key, connection_hdl hdl, const topicHandler& onLast = nullptr) {
+            shard& target = shard_for(key);
+            lock_guard<mutex> lock(target.mutex_);
+            auto it = target.topics.find(key);
+            if (it == target.topics.end()) return false;
+
+            shared_ptr<const subscriberList> current = it->second->subscribers();
+            auto next = make_shared<subscriberList>();
+            next->reserve(current->size());
+            for (auto& existing : *current) {
+                if (!same(existing.hdl, hdl)) next->push_back(existing);
+            }
+            if (next->size() == current->size()) return false;
+
+            bool last = next->empty();
+            it->second->publish(move(next));
+            if (last) {
+                if (onLast) onLast(it->second);
+                target.topics.erase(it);
+            }
+            return true;
+        }
+
+        shared_ptr<topic> find(uint32_t key) {
+            shard& target = shard_for(key);
+            lock_guard<mutex> lock(target.mutex_);
+            auto it = target.topics.find(key);
+            return (it != target.topics.end()) ? it->second : nullptr;
+        }
+
+        size_t topic_count() {
+            size_t total = 0;
+            for (auto& entry : shards_) {
+                lock_guard<mutex> lock(entry.mutex_);
+                total += entry.topics.size();
+            }
+            return total;
+        }
+
+    private:
+        struct shard {
+            mutex mutex_;
+            unordered_map<uint32_t, shared_ptr<topic>> topics;   // <Topic key, Topic>
+        };
+
+        array<shard, SUBSCRIPTION_SHARDS> shards_;
+        atomic<uint64_t> next_id_{1};
+
+        shard& shard_for(uint32_t key) {
+            return shards_[key % SUBSCRIPTION_SHARDS];
+        }
+
+        static bool same(const connection_hdl& lhs, const connection_hdl& rhs) {
+            return !lhs.owner_before(rhs) && !rhs.owner_before(lhs);
+        }
+};
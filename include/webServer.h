@@ -1,16 +1,29 @@
+#pragma once
 #include <iostream>
 #include <unordered_map>
-#include <unordered_set>
 #include <thread>
+#include <vector>
+#include <array>
 #include <chrono>
 #include <functional>
 #include <mutex>
 #include <websocketpp/config/asio.hpp>       // WebSocket++ ASIO integration
 #include <websocketpp/config/asio_no_tls.hpp>
-#include <websocketpp/config/asio_client.hpp>
 #include <websocketpp/server.hpp>
-#include <websocketpp/client.hpp>
+#include <websocketpp/extensions/permessage_deflate/enabled.hpp>
 #include <nlohmann/json.hpp>                // JSON parsing/manipulation
+#include "bookFeed.h"                       // Incremental book maintenance
+#include "bookFrame.h"                      // Binary book frames
+#include "bookAnalytics.h"                  // Incremental book metrics
+#include "deribitSession.h"                 // Shared upstream connections
+#include "clientQueue.h"                    // Per-client conflating send queues
+#include "subscriptionRegistry.h"           // Sharded copy-on-write subscriber lists
+#include "latencyStats.h"                   // Latency histograms
+#include "captureLog.h"                     // Upstream capture and replay
+#include "lowLatency.h"                     // Pinned polling threads and SPSC rings
+#include "internTable.h"                    // Recycled instrument ids
+#include "payloadPool.h"                    // Recycled update buffers
+#include "utils.h"
 
 using namespace std;
 using websocketpp::connection_hdl;
@@ -19,9 +32,23 @@ using websocketpp::lib::placeholders::_2;
 using websocketpp::lib::bind;
 using json = nlohmann::json;
 
-// WebSocket server/client types
-using server = websocketpp::server<websocketpp::config::asio>;
-using client = websocketpp::client<websocketpp::config::asio_tls_client>;
+// Server config with permessage-deflate: clients that offer the extension get compressed frames
+struct deflateServerConfig : public websocketpp::config::asio {
+    struct permessage_deflate_config {};
+    typedef websocketpp::extensions::permessage_deflate::enabled<permessage_deflate_config> permessage_deflate_type;
+};
+
+// WebSocket server type
+using server = websocketpp::server<deflateServerConfig>;
+static_assert(is_same<server::message_ptr, sharedPayload>::value, "Queued updates must be the server's message type");
+
+const size_t MAX_BUFFERED_BYTES = 1 << 20;   // Stop writing to a client with 1 MB unsent
+const long SLOW_CLIENT_RETRY_MS = 5;         // Re-check a backed-up client after this delay
+const long DEFAULT_STATS_DUMP_S = 60;        // Periodic latency dump interval
+const size_t CONNECTION_SHARDS = 16;         // Independent locks over the connection table
+const long long DEFAULT_LIVE_BOOK_AGE_MS = 1000;   // live_book staleness budget without DERIBIT_BOOK_CACHE_MS
+const long long MAX_SUBSCRIPTION_DEPTH = 10000;   // Deepest book Deribit serves; binary frames count levels in 16 bits
+static_assert(MAX_SUBSCRIPTION_DEPTH <= 65535, "Subscription depth must fit bookFrameHeader::depth");
 
 // Custom hash specialization for WebSocket++ connection handles
 namespace std {
@@ -44,13 +71,58 @@ namespace std {
 }
 
 // ======== orderBookServer Class ========
+// The server runs on a pool of io threads. Per-connection state lives in a sharded table
+// and subscriber lists are copy-on-write topics, so publishing an update takes no lock;
+// only connect, disconnect, subscribe and unsubscribe synchronize, each on one shard.
+//
+// In low-latency mode every upstream channel is read by one pinned, polling ingest thread.
+// It hands each serialized update to a fixed set of pinned, polling fan-out threads through
+// one SPSC ring per thread, so the ingest thread never waits on a lock or an io thread. Every
+// connection belongs to one fan-out thread, which walks only its own connections, queues
+// the update for each and hands it to websocketpp. The socket write itself still runs on the
+// connection's io strand, and the per-client queue takes that client's own mutex.
 class orderBookServer {
     public:
-        orderBookServer() {
+        // Handles an `order` command; `reply` sends the response text back to the client
+        using orderHandler = function<void(const json& request, function<void(const string&)> reply)>;
+
+        orderBookServer() : orderBookServer(readEnv(ENV_FIlE)) {}
+
+        // Reads upstream settings, STATS_DUMP_INTERVAL_S (0 disables the periodic dump),
+        // SERVER_IO_THREADS (defaults to the number of cores), the capture/replay settings
+        // CAPTURE_DIR, CAPTURE_SEGMENT_MB, REPLAY_DIR and REPLAY_SPEED (1 = real time, 0 = max),
+        // the LOW_LATENCY_* thread layout, ORDER_COMMAND_TOKEN and DERIBIT_BOOK_CACHE_MS (the
+        // staleness budget of live_book)
+        explicit orderBookServer(const unordered_map<string, string>& env)
+            : low_latency_(lowLatencyConfig::fromEnv(env)),
+              upstream_(upstream_config(env)),
+              upstream_to_enqueue_(latencyStats().histogram("server.upstream_to_enqueue")),
+              upstream_to_send_(latencyStats().histogram("server.upstream_to_send")) {
+            auto it = env.find("STATS_DUMP_INTERVAL_S");
+            if (it != env.end()) {
+                try { stats_dump_interval_s_ = stol(it->second); } catch (const exception&) {}
+            }
+            io_threads_ = max<size_t>(1, thread::hardware_concurrency());
+            it = env.find("SERVER_IO_THREADS");
+            if (it != env.end()) {
+                try { io_threads_ = max(1, stoi(it->second)); } catch (const exception&) {}
+            }
+            it = env.find("ORDER_COMMAND_TOKEN");
+            if (it != env.end()) order_token_ = it->second;
+            it = env.find("DERIBIT_BOOK_CACHE_MS");
+            if (it != env.end() && !it->second.empty()) {
+                try { live_book_age_ms_ = stoll(it->second); } catch (const exception&) {}
+            }
+            setup_capture(env);
+            if (low_latency_.enabled) {
+                for (size_t i = 0; i < low_latency_.fanoutCores.size(); ++i) fanout_.push_back(make_unique<fanoutLane>());
+            }
+
             // Initialize server components
             server_.init_asio();
             
             // Register handler callbacks
+            server_.set_validate_handler(bind(&orderBookServer::on_validate, this, _1));
             server_.set_open_handler(bind(&orderBookServer::on_open, this, _1));
             server_.set_message_handler(bind(&orderBookServer::on_message, this, _1, _2));
             server_.set_close_handler(bind(&orderBookServer::on_close, this, _1));
@@ -63,174 +135,823 @@ class orderBookServer {
             server_.start_accept();  // Begin accepting connections
         }
 
+        // Runs the event loop on SERVER_IO_THREADS threads, the caller being one of them,
+        // and in low-latency mode the fan-out threads alongside
         void run() {
-            cout << "WebSocket server started!" << endl;
+            cout << "WebSocket server started with " << io_threads_ << " io threads!" << endl;
+            if (!fanout_.empty()) cout << "Low-latency mode with " << fanout_.size() << " fan-out threads" << endl;
+            latencyStats().startPeriodicDump(stats_dump_interval_s_);
+
+            fanout_running_.store(true, memory_order_release);
+            for (size_t i = 0; i < fanout_.size(); ++i) {
+                fanout_[i]->worker = thread([this, i] { run_fanout(i); });
+            }
+            vector<thread> pool;
+            for (size_t i = 1; i < io_threads_; ++i) {
+                pool.emplace_back([this] { server_.run(); });
+            }
             server_.run();  // Start the ASIO event loop
+            for (auto& worker : pool) worker.join();
+
+            fanout_running_.store(false, memory_order_release);
+            for (auto& lane : fanout_) lane->worker.join();
+        }
+
+        // Accepts {"method": "order", "token": ..., "request": {"method": ..., "params": {...}}}
+        // from clients. Set before run(); without a handler the command is ignored. Orders trade
+        // the account, so the command is off unless ORDER_COMMAND_TOKEN is set, and it is only
+        // taken from loopback peers that send that token.
+        void set_order_handler(orderHandler handler) {
+            order_handler_ = move(handler);
+            if (order_token_.empty()) cerr << "Order commands disabled: ORDER_COMMAND_TOKEN is not set" << endl;
+        }
+
+        // Stops accepting clients and ends run()
+        void stop() {
+            websocketpp::lib::error_code ec;
+            server_.stop_listening(ec);
+            server_.stop();
+        }
+
+        // Writes the top `depth` levels (all of them for 0) of `symbol` from a streamed local book
+        // into `out`, shaped like a `public/get_order_book` response. Returns false when neither
+        // the raw nor the 100ms channel of the symbol is streamed with a synced book updated
+        // within the staleness budget, e.g. while its upstream session is reconnecting (agg2
+        // books are price-aggregated and never served). Any thread.
+        bool live_book(const string& symbol, long long depth, string& out) {
+            shared_ptr<streamFeed> feeds[2];
+            {
+                // A feed's running groups hold its instrument id, so under the lock the id
+                // found for the symbol is the one its feeds are keyed by
+                lock_guard<mutex> lock(feeds_mutex_);
+                uint32_t instrument = instruments_.find(symbol);
+                if (instrument == 0) return false;
+                const char* intervals[2] = {"raw", "100ms"};   // Freshest first
+                for (size_t i = 0; i < 2; ++i) {
+                    auto it = stream_feeds_.find(feed_key(instrument, intervals[i]));
+                    if (it != stream_feeds_.end()) feeds[i] = it->second;
+                }
+            }
+
+            thread_local vector<bookLevel> scratch;
+            auto oldest = chrono::steady_clock::now() - chrono::milliseconds(live_book_age_ms_);
+            for (auto& feed : feeds) {
+                if (!feed) continue;
+                lock_guard<mutex> lock(feed->book_mutex_);
+                if (!feed->book.synced() || feed->updated < oldest) continue;
+                const orderBook& book = feed->book.book();
+                size_t levels = (depth > 0) ? (size_t)depth : max(book.depth(bookSide::bid), book.depth(bookSide::ask));
+                feed->book.writeTop((int)levels, out, scratch);
+                return true;
+            }
+            return false;
+        }
+
+        // Size of everything that grows with subscriptions. Each figure returns to its idle value
+        // once the clients are gone, however long the server has been up.
+        json registry_stats() {
+            size_t activeGroups, feeds;
+            {
+                lock_guard<mutex> lock(feeds_mutex_);
+                activeGroups = groups_.size();
+                feeds = stream_feeds_.size();
+            }
+            size_t clients = 0;
+            for (auto& shard : connections_) {
+                lock_guard<mutex> lock(shard.mutex_);
+                clients += shard.clients.size();
+            }
+            return {
+                {"clients", clients},
+                {"topics", subscriptions_.topic_count()},
+                {"groups", activeGroups},
+                {"stream_feeds", feeds},
+                {"group_keys", group_keys_.size()},
+                {"instruments", instruments_.size()},
+                {"upstream_references", upstream_.references()},
+                {"upstream_channels", upstream_.channel_count()},
+                {"upstream_connected", upstream_.connected_count()}
+            };
+        }
+
+        // Fan-out health: queue depth, conflation/drop counts and enqueue-to-send latency
+        json fanout_stats() {
+            vector<shared_ptr<clientQueue>> queues;
+            for (auto& shard : connections_) {
+                lock_guard<mutex> lock(shard.mutex_);
+                for (auto& entry : shard.clients) queues.push_back(entry.second->queue);
+            }
+
+            uint64_t ringStalls = 0;
+            for (auto& lane : fanout_) ringStalls += lane->stalls.load(memory_order_relaxed);
+
+            size_t totalDepth = 0, maxDepth = 0;
+            uint64_t conflated = 0, dropped = 0, sent = 0, latencyTotalNs = 0, latencyMaxNs = 0;
+            for (auto& queue : queues) {
+                size_t depth = queue->depth();
+                totalDepth += depth;
+                maxDepth = max(maxDepth, depth);
+                conflated += queue->conflated();
+                dropped += queue->dropped();
+                sent += queue->sent();
+                latencyTotalNs += queue->latency_total_ns();
+                latencyMaxNs = max(latencyMaxNs, queue->latency_max_ns());
+            }
+            return {
+                {"clients", queues.size()},
+                {"groups", subscriptions_.topic_count()},
+                {"queue_depth", totalDepth},
+                {"max_queue_depth", maxDepth},
+                {"sent", sent},
+                {"conflated", conflated},
+                {"dropped", dropped},
+                {"avg_send_latency_us", sent ? latencyTotalNs / sent / 1000.0 : 0.0},
+                {"max_send_latency_us", latencyMaxNs / 1000.0},
+                {"fanout_threads", fanout_.size()},
+                {"ring_stalls", ringStalls}
+            };
         }
 
     private:
+        // What a subscription group delivers: one symbol at one depth, either streamed at
+        // an upstream book interval or polled every `timeout` seconds. Analytics groups
+        // deliver metrics of the top `depth` levels instead of the levels and are always streamed.
+        struct groupSpec {
+            string symbol;
+            int depth;
+            string interval;   // "raw" / "100ms" / "agg2"; empty for polling
+            int timeout;       // Seconds between polls
+            bool binary;       // Binary frames instead of JSON
+            bool analytics;    // The `analytics` channel instead of the book
+            uint32_t instrument = 0;   // Interned id of `symbol`, held while the group runs
+
+            // Name of the group; interned in group_keys_ to key the registry
+            string key() const {
+                string mode = interval.empty() ? "poll" + to_string(timeout) + "s" : interval;
+                return symbol + (analytics ? ".analytics." : ".") + mode + ".d" + to_string(depth) + (binary ? ".bin" : "");
+            }
+
+            // A client holds one book group and one analytics group per symbol: <Instrument id, Channel>
+            uint64_t slot(uint32_t id) const {
+                return ((uint64_t)id << 1) | (analytics ? 1 : 0);
+            }
+        };
+
+        // A depth group served from a streamed book; binary groups carry their frame encoder,
+        // analytics groups their running metrics
+        struct depthGroup {
+            int depth;
+            shared_ptr<topic> group;
+            shared_ptr<bookFrameEncoder> encoder;
+            shared_ptr<bookAnalytics> analytics;
+            bool binary;
+        };
+
+        // One upstream `book.{symbol}.{interval}` channel and the local book it maintains,
+        // shared by every depth group on that channel. Only the session thread changes the
+        // book, under book_mutex_ so live_book can read it from other threads; the group
+        // list is swapped atomically when groups come and go.
+        struct streamFeed {
+            explicit streamFeed(const string& symbol) : book(symbol) {}
+
+            mutex book_mutex_;
+            bookFeed book;
+            chrono::steady_clock::time_point updated;   // Arrival of the last change applied to the book
+            shared_ptr<const vector<depthGroup>> groups = make_shared<const vector<depthGroup>>();
+        };
+
+        // One update on its way from the ingest thread to a fan-out thread
+        struct fanoutTask {
+            shared_ptr<topic> group;
+            shared_ptr<const laneLists> lanes;        // The topic's subscribers by lane
+            sharedPayload payload;
+            sharedPayload resync;
+            chrono::steady_clock::time_point received;
+        };
+
+        // A fan-out thread and the ring the ingest thread feeds it through
+        struct fanoutLane {
+            spscRing<fanoutTask> ring;
+            thread worker;
+            atomic<uint64_t> stalls{0};                // Times the ingest thread found the ring full
+        };
+
+        // One group a client is in, with the ids it holds while there
+        struct clientGroup {
+            uint32_t key = 0;                          // Reference on the interned group key
+            uint64_t topicId = 0;
+            uint32_t instrument = 0;                   // Reference on the interned symbol
+        };
+
+        // Everything the server keeps per connection
+        struct clientState {
+            bool binary = false;                       // Negotiated BOOK_FRAME_PROTOCOL
+            size_t lane = 0;                           // Fan-out thread in low-latency mode
+            bool shareFrames = false;                  // Takes shared prepared frames (no per-connection deflate)
+            shared_ptr<clientQueue> queue = make_shared<clientQueue>();
+            mutex mutex_;                              // Protects groups
+            unordered_map<uint64_t, clientGroup> groups; // <groupSpec::slot(), Group>
+        };
+
+        struct connectionShard {
+            mutex mutex_;
+            unordered_map<connection_hdl, shared_ptr<clientState>,
+            hash<connection_hdl>,
+            equal_to<connection_hdl>
+            > clients;
+        };
+
         // ------ Core Components ------
         server server_;  // WebSocket server instance
-        mutex clients_mutex_;       // Protects client connections
-        mutex subscriptions_mutex_; // Protects subscription data
-
-        // Subscription tracking: <Symbol, Connected Clients>
-        unordered_map<string, 
-        unordered_set<connection_hdl, 
-        hash<connection_hdl>,
-        equal_to<connection_hdl>  // Explicit equal_to specification
-        >> subscriptions;
-        unordered_map<connection_hdl, unordered_set<string>, 
-        hash<connection_hdl>, 
-        equal_to<connection_hdl>  // Add equality comparison
-        > connection_symbols;
-
-        // Active Deribit connections: <Symbol, WebSocket Client>
-        unordered_map<string, shared_ptr<client>> deribit_connections;
+        size_t io_threads_ = 1;
+        orderHandler order_handler_;   // Order commands, when the server runs next to an order stream
+        string order_token_;           // Shared secret of order commands; empty disables them
+        lowLatencyConfig low_latency_;
+
+        // Low-latency fan-out threads; empty otherwise
+        vector<unique_ptr<fanoutLane>> fanout_;
+        atomic<bool> fanout_running_{false};
+        atomic<size_t> next_lane_{0};             // Round-robin lane assignment of new connections
+
+        // Connected clients: <Client, State>, sharded by handle
+        array<connectionShard, CONNECTION_SHARDS> connections_;
+
+        // Subscriber lists by interned group key
+        subscriptionRegistry subscriptions_;
+
+        // Upstream Deribit sessions shared by all symbols
+        deribitSessionPool upstream_;
+        shared_ptr<captureWriter> capture_;       // Records upstream frames when CAPTURE_DIR is set
+        unique_ptr<captureReplayer> replay_;      // Stands in for Deribit when REPLAY_DIR is set
+
+        // Active groups and upstream feeds, guarded by feeds_mutex_
+        mutex feeds_mutex_;
+        unordered_map<uint32_t, groupSpec> groups_;                     // <Group key id, Spec>
+        unordered_map<uint64_t, shared_ptr<streamFeed>> stream_feeds_;  // <feed_key(), Feed>
+
+        // Instrument ids used in binary frames and in feed and client slot keys, held by every
+        // client subscription and running group; an id is reused once nobody watches its symbol
+        internTable instruments_;
+
+        // Ids of groupSpec::key(), held by every client in the group; the registry is keyed by them
+        internTable group_keys_;
+
+        // ------ Latency Tracking ------
+        latencyHistogram& upstream_to_enqueue_;   // Upstream receive -> queued for clients
+        latencyHistogram& upstream_to_send_;      // Upstream receive -> written to a client socket
+        long stats_dump_interval_s_ = DEFAULT_STATS_DUMP_S;
+        long long live_book_age_ms_ = DEFAULT_LIVE_BOOK_AGE_MS;
+
+        // Replay runs the sessions offline: they never connect and only see replayed frames.
+        // Low-latency mode reads every channel on one session, whose thread is the ingest thread.
+        static sessionConfig upstream_config(const unordered_map<string, string>& env) {
+            sessionConfig config = sessionConfig::fromEnv(env);
+            auto it = env.find("REPLAY_DIR");
+            config.offline = (it != env.end() && !it->second.empty());
+            lowLatencyConfig lowLatency = lowLatencyConfig::fromEnv(env);
+            if (lowLatency.enabled) {
+                config.sessions = 1;
+                config.dedicate(lowLatency.ingestCore, lowLatency.busyPoll);
+            }
+            return config;
+        }
+
+        void setup_capture(const unordered_map<string, string>& env) {
+            auto it = env.find("REPLAY_DIR");
+            if (it != env.end() && !it->second.empty()) {
+                double speed = 1;
+                auto speedIt = env.find("REPLAY_SPEED");
+                if (speedIt != env.end()) {
+                    if (speedIt->second == "max") speed = 0;
+                    else try { speed = stod(speedIt->second); } catch (const exception&) {}
+                }
+                replay_ = make_unique<captureReplayer>(it->second, speed);
+                cout << "Replaying " << it->second << " in place of Deribit" << endl;
+                return;
+            }
+
+            it = env.find("CAPTURE_DIR");
+            if (it == env.end() || it->second.empty()) return;
+            size_t segmentBytes = CAPTURE_DEFAULT_SEGMENT_BYTES;
+            auto sizeIt = env.find("CAPTURE_SEGMENT_MB");
+            if (sizeIt != env.end()) {
+                try { segmentBytes = (size_t)max(1, stoi(sizeIt->second)) << 20; } catch (const exception&) {}
+            }
+            capture_ = make_shared<captureWriter>(it->second, segmentBytes);
+            upstream_.set_capture(capture_);
+            cout << "Capturing upstream messages to " << it->second << endl;
+        }
+
+        connectionShard& shard_for(const connection_hdl& hdl) {
+            return connections_[hash<connection_hdl>()(hdl) % CONNECTION_SHARDS];
+        }
+
+        shared_ptr<clientState> client_for(const connection_hdl& hdl) {
+            connectionShard& shard = shard_for(hdl);
+            lock_guard<mutex> lock(shard.mutex_);
+            auto it = shard.clients.find(hdl);
+            return (it != shard.clients.end()) ? it->second : nullptr;
+        }
 
         // ------ Connection Handlers ------
+        // Clients opt into binary book frames by requesting BOOK_FRAME_PROTOCOL as a subprotocol
+        bool on_validate(connection_hdl hdl) {
+            server::connection_ptr con = server_.get_con_from_hdl(hdl);
+            for (const string& protocol : con->get_requested_subprotocols()) {
+                if (protocol == BOOK_FRAME_PROTOCOL) {
+                    con->select_subprotocol(protocol);
+                    break;
+                }
+            }
+            return true;
+        }
+
         void on_open(connection_hdl hdl) {
-            lock_guard<mutex> lock(clients_mutex_);
-            connection_symbols[hdl] = {};
+            auto client = make_shared<clientState>();
+            websocketpp::lib::error_code ec;
+            server::connection_ptr con = server_.get_con_from_hdl(hdl, ec);
+            if (!ec) {
+                client->binary = (con->get_subprotocol() == BOOK_FRAME_PROTOCOL);
+                // A shared frame is sent as is, so only RFC 6455 framing without permessage-deflate takes one
+                client->shareFrames = !con->get_request_header("Sec-WebSocket-Version").empty()
+                                      && con->get_response_header("Sec-WebSocket-Extensions").empty();
+            }
+            if (!fanout_.empty()) client->lane = next_lane_.fetch_add(1, memory_order_relaxed) % fanout_.size();
+
+            connectionShard& shard = shard_for(hdl);
+            lock_guard<mutex> lock(shard.mutex_);
+            shard.clients[hdl] = client;
         }
 
         void on_message(connection_hdl hdl, server::message_ptr msg) {
-            lock_guard<mutex> lock(clients_mutex_);
-            string payload = msg->get_payload();
+            const string& payload = msg->get_payload();
 
             try {
                 auto json_msg = json::parse(payload);
                 
                 // Handle subscription requests
                 if (json_msg["method"] == "subscribe" && json_msg.contains("symbol")) {
-                    string symbol = json_msg["symbol"];
-                    int depth = json_msg.value("depth", 5);       // Default 5 levels
-                    int timeout = max(1, json_msg.value("timeout", 5));  // Min 1 sec
-                    
-                    cout << "New subscription to " << symbol << endl;
-                    {
-                        lock_guard<mutex> sub_lock(subscriptions_mutex_);
-                        subscriptions[symbol].insert(hdl);  // Add client to symbol group
+                    // The depth sizes buffers on the shared upstream thread, so it is bounded up front
+                    long long depth = json_msg.value("depth", 5LL);       // Default 5 levels
+                    if (depth > MAX_SUBSCRIPTION_DEPTH) {
+                        json reply = {{"error", {{"message", "depth must be at most " + to_string(MAX_SUBSCRIPTION_DEPTH)}}}};
+                        websocketpp::lib::error_code ec;
+                        server_.send(hdl, reply.dump(), websocketpp::frame::opcode::text, ec);
+                        return;
                     }
-
-                    // Create Deribit connection if first subscriber
-                    if (!deribit_connections.count(symbol)) {
-                        thread(&orderBookServer::connect_to_deribit, 
-                             this, symbol, depth, timeout).detach();
+                    groupSpec spec;
+                    spec.symbol = json_msg["symbol"];
+                    spec.depth = (int)max(1LL, depth);
+                    spec.timeout = max(1, json_msg.value("timeout", 5));   // Min 1 sec
+                    spec.interval = json_msg.value("interval", "");        // "raw" / "100ms" streams changes instead of polling
+                    spec.analytics = json_msg.value("channel", "book") == "analytics";
+                    if (spec.analytics && spec.interval.empty()) spec.interval = "100ms";   // Metrics need a streamed book
+                    if (!spec.interval.empty() && spec.interval != "raw" && spec.interval != "100ms" && spec.interval != "agg2") {
+                        cerr << "Unsupported interval: " << spec.interval << endl;
+                        return;
                     }
+
+                    shared_ptr<clientState> client = client_for(hdl);
+                    if (!client) return;
+                    spec.binary = client->binary;
+                    
+                    cout << "New subscription to " << spec.symbol << endl;
+                    subscribe(hdl, client, spec);
                 }
                 else if (json_msg["method"] == "unsubscribe" && json_msg.contains("symbol")) {
                     string symbol = json_msg["symbol"];
-                    {
-                        lock_guard<mutex> sub_lock(subscriptions_mutex_);
-                        if (subscriptions.count(symbol)) {
-                            subscriptions[symbol].erase(hdl);
-                            
-                            // Remove symbol entry if no subscribers left
-                            if (subscriptions[symbol].empty()) {
-                                subscriptions.erase(symbol);
-                                
-                                // Cleanup Deribit connection
-                                if (deribit_connections.count(symbol)) {
-                                    deribit_connections[symbol]->stop();
-                                    deribit_connections.erase(symbol);
-                                }
+                    groupSpec spec{};
+                    spec.symbol = symbol;
+                    spec.analytics = json_msg.value("channel", "book") == "analytics";
+                    uint32_t instrument = instruments_.find(symbol);   // Held by this client if subscribed
+                    shared_ptr<clientState> client = instrument ? client_for(hdl) : nullptr;
+                    if (client) {
+                        clientGroup group;
+                        {
+                            lock_guard<mutex> lock(client->mutex_);
+                            auto it = client->groups.find(spec.slot(instrument));
+                            if (it != client->groups.end()) {
+                                group = move(it->second);
+                                client->groups.erase(it);
                             }
                         }
+                        if (group.key) leave_group(hdl, *client, group);
                     }
                     cout << "Unsubscribed from " << symbol << endl;
                 }
+                else if (json_msg["method"] == "order" && json_msg.contains("request") && order_handler_) {
+                    if (!order_permitted(hdl, json_msg.value("token", ""))) {
+                        websocketpp::lib::error_code ec;
+                        server_.send(hdl, R"({"error":{"message":"order command not permitted"}})", websocketpp::frame::opcode::text, ec);
+                        return;
+                    }
+                    order_handler_(json_msg["request"], [this, hdl](const string& response) {
+                        websocketpp::lib::error_code ec;
+                        server_.send(hdl, response, websocketpp::frame::opcode::text, ec);
+                    });
+                }
+                else if (json_msg["method"] == "stats") {
+                    json reply = {{"fanout", fanout_stats()}, {"registry", registry_stats()}, {"latency", latencyStats().snapshot()}};
+                    if (capture_) reply["capture"] = {{"records", capture_->records()}, {"dropped", capture_->dropped()}};
+                    if (replay_) reply["replay"] = {{"delivered", replay_->delivered()}, {"finished", replay_->finished()}};
+                    server_.send(hdl, reply.dump(), websocketpp::frame::opcode::text);
+                }
             } catch (const exception& e) {
                 cerr << "JSON Error: " << e.what() << endl;
             }
         }
 
+        // An order command needs the configured token and a peer on this machine
+        bool order_permitted(connection_hdl hdl, const string& token) {
+            if (order_token_.empty() || token.size() != order_token_.size()) return false;
+            unsigned char diff = 0;   // Compared in full so the time taken says nothing about the token
+            for (size_t i = 0; i < token.size(); ++i) diff |= (unsigned char)(token[i] ^ order_token_[i]);
+            if (diff != 0) return false;
+
+            websocketpp::lib::error_code ec;
+            server::connection_ptr con = server_.get_con_from_hdl(hdl, ec);
+            if (ec) return false;
+            websocketpp::lib::asio::error_code socketError;
+            auto peer = con->get_raw_socket().remote_endpoint(socketError);
+            return !socketError && peer.address().is_loopback();
+        }
+
         void on_close(connection_hdl hdl) {
-            lock_guard<mutex> lock(clients_mutex_);
-            // Cleanup all subscriptions for disconnected client
-            for (auto& symbol : connection_symbols[hdl]) {
-                subscriptions[symbol].erase(hdl);
+            shared_ptr<clientState> client;
+            {
+                connectionShard& shard = shard_for(hdl);
+                lock_guard<mutex> lock(shard.mutex_);
+                auto it = shard.clients.find(hdl);
+                if (it == shard.clients.end()) return;
+                client = it->second;
+                shard.clients.erase(it);
+            }
+
+            // Leave every group, releasing the topic, instrument and upstream references it held
+            unordered_map<uint64_t, clientGroup> groups;
+            {
+                lock_guard<mutex> lock(client->mutex_);
+                groups.swap(client->groups);
+            }
+            for (auto& entry : groups) {
+                leave_group(hdl, *client, entry.second);
             }
-            connection_symbols.erase(hdl);
         }
 
-        // ------ Deribit Integration ------
-        void connect_to_deribit(const string& symbol, int depth, int timeout) {
-            shared_ptr<client> deribit_client = make_shared<client>();
-            deribit_client->init_asio();
-
-            // Configure SSL context for WSS connection
-            auto ctx = websocketpp::lib::make_shared<websocketpp::lib::asio::ssl::context>(
-                websocketpp::lib::asio::ssl::context::sslv23
-            );
-            ctx->set_options(websocketpp::lib::asio::ssl::context::default_workarounds);
-            ctx->set_verify_mode(websocketpp::lib::asio::ssl::verify_none);
-            
-            deribit_client->set_tls_init_handler([ctx](connection_hdl) {
-                return ctx;
+        // ------ Subscription Groups ------
+        // Clients asking for the same symbol, depth and interval share one group, whose update
+        // is built and serialized once per tick. A client holds one group per symbol and channel;
+        // a new subscribe for the symbol moves it to the group matching the new parameters.
+        // A connection's handlers never run concurrently, so its slots change one message at a time.
+        // Every membership holds a reference on its group key and instrument ids.
+        void subscribe(connection_hdl hdl, const shared_ptr<clientState>& client, const groupSpec& spec) {
+            uint32_t instrument = instruments_.acquire(spec.symbol);
+            uint32_t key = group_keys_.acquire(spec.key());
+            clientGroup previous;
+            bool member = false;
+            {
+                lock_guard<mutex> lock(client->mutex_);
+                clientGroup& slot = client->groups[spec.slot(instrument)];
+                member = (slot.key == key);
+                if (!member) {
+                    previous = move(slot);
+                    slot = clientGroup{key, 0, instrument};
+                }
+            }
+            if (member) {                                 // Already in this group
+                group_keys_.release(key);
+                instruments_.release(instrument);
+                return;
+            }
+            if (previous.key) leave_group(hdl, *client, previous);
+
+            // Binary clients learn the instrument id before the first frame can be queued
+            if (spec.binary) {
+                json reply = {
+                    {"method", "subscribed"},
+                    {"channel", spec.analytics ? "analytics" : "book"},
+                    {"symbol", spec.symbol},
+                    {"instrument_id", instrument},
+                    {"depth", spec.depth}
+                };
+                websocketpp::lib::error_code ec;
+                server_.send(hdl, reply.dump(), websocketpp::frame::opcode::text, ec);
+            }
+
+            // The first subscriber of a group starts serving it. A topic id is never reused, so
+            // a binary client always starts the group on a snapshot.
+            subscriptions_.add(key, spec.key(), subscriber{hdl, client->queue, client->lane, client->shareFrames},
+                               [this, spec](const shared_ptr<topic>& group) {
+                start_group(group, spec);
             });
+            shared_ptr<topic> joined = subscriptions_.find(key);
 
-            auto isConnected = make_shared<bool>(true);
+            lock_guard<mutex> lock(client->mutex_);
+            auto slot = client->groups.find(spec.slot(instrument));
+            if (slot != client->groups.end() && slot->second.key == key) slot->second.topicId = joined ? joined->id() : 0;
+        }
 
-            // Handle incoming Deribit messages
-            deribit_client->set_message_handler(
-            [this, isConnected, symbol](connection_hdl, client::message_ptr msg) {
-                broadcast_to_clients(symbol, msg->get_payload());
+        // The last subscriber out stops the group, and its upstream feed if no group still uses it.
+        // The client's queue drops what it still held for the group.
+        void leave_group(connection_hdl hdl, clientState& client, const clientGroup& group) {
+            subscriptions_.remove(group.key, hdl, [this](const shared_ptr<topic>& stopped) {
+                stop_group(*stopped);
             });
+            if (group.topicId) client.queue->forget(group.topicId);
+            group_keys_.release(group.key);
+            instruments_.release(group.instrument);
+        }
+
+        // Runs under the group's registry shard lock. Every running group holds a reference on
+        // its instrument id and on its upstream session.
+        void start_group(const shared_ptr<topic>& group, groupSpec spec) {
+            lock_guard<mutex> lock(feeds_mutex_);
+            spec.instrument = instruments_.acquire(spec.symbol);
+            upstream_.acquire(spec.symbol);
+            groups_[group->key()] = spec;
+            if (spec.interval.empty()) {
+                connect_to_deribit(group, spec);
+            } else {
+                stream_from_deribit(group, spec);
+            }
+        }
 
-            // Handle Deribit connection establishment
-            deribit_client->set_open_handler(
-            [this, symbol, depth, timeout, isConnected, deribit_client](connection_hdl ws_hdl) {
-                thread([this, symbol, depth, timeout, ws_hdl, isConnected, deribit_client]() {
-                    // Regular order book polling
-                    while (*isConnected) {
-                        json msg = {
-                            {"jsonrpc", "2.0"},
-                            {"method", "public/get_order_book"},
-                            {"params", {
-                                {"instrument_name", symbol}, 
-                                {"depth", depth}
-                            }}
-                        };
-                        deribit_client->send(ws_hdl, msg.dump(), 
-                                           websocketpp::frame::opcode::text);
-                        this_thread::sleep_for(chrono::seconds(timeout));
+        void stop_group(const topic& group) {
+            lock_guard<mutex> lock(feeds_mutex_);
+            auto it = groups_.find(group.key());
+            if (it == groups_.end()) return;
+            groupSpec spec = it->second;
+            groups_.erase(it);
+
+            deribitSession& session = upstream_.session_for(spec.symbol);
+            if (spec.interval.empty()) {
+                session.stop_poll(group.name());
+            } else {
+                string channel = "book." + spec.symbol + "." + spec.interval;
+                auto feed = stream_feeds_.find(feed_key(spec.instrument, spec.interval));
+                if (feed != stream_feeds_.end()) {
+                    auto remaining = make_shared<vector<depthGroup>>();
+                    for (auto& entry : *atomic_load(&feed->second->groups)) {
+                        if (entry.group.get() != &group) remaining->push_back(entry);
                     }
-                    // Cleanup closed connection
-                    deribit_client->close(ws_hdl, 
-                        websocketpp::close::status::normal, 
-                        "Connection closure");
-                }).detach();
-            });
+                    if (remaining->empty()) {
+                        session.unsubscribe(channel);
+                        stream_feeds_.erase(feed);
+                    } else {
+                        atomic_store(&feed->second->groups, shared_ptr<const vector<depthGroup>>(remaining));
+                    }
+                }
+            }
+            upstream_.release(spec.symbol);
+            instruments_.release(spec.instrument);
+        }
 
-            // Establish Deribit connection
-            websocketpp::lib::error_code ec;
-            auto con = deribit_client->get_connection(
-                "wss://test.deribit.com/ws/api/v2", ec);
-            
-            if (ec) {
-                cerr << "Connection Error: " << ec.message() << endl;
+        // Key of the upstream channel of an instrument at an interval ("raw", "100ms" or "agg2")
+        static uint64_t feed_key(uint32_t instrument, const string& interval) {
+            uint64_t index = (interval == "raw") ? 0 : (interval == "100ms") ? 1 : 2;
+            return ((uint64_t)instrument << 2) | index;
+        }
+
+        // ------ Deribit Integration ------
+        // All feeds share the upstream session pool; nothing here opens a connection or a thread.
+        // Handlers run on the owning session's event loop and publish to the groups they were
+        // started for without looking anything up. Callers hold feeds_mutex_.
+
+        // Polling mode: requests a full snapshot at the group's depth every `timeout` seconds.
+        // JSON groups relay the response as is; binary groups re-encode it against the last poll.
+        void connect_to_deribit(const shared_ptr<topic>& group, const groupSpec& spec) {
+            shared_ptr<bookFrameEncoder> encoder;
+            if (spec.binary) encoder = make_shared<bookFrameEncoder>(spec.instrument, spec.depth);
+
+            upstream_.session_for(spec.symbol).poll(group->name(), "public/get_order_book",
+                {{"instrument_name", spec.symbol}, {"depth", spec.depth}}, spec.timeout * 1000L,
+                [this, group, encoder](string_view response) {
+                    if (!encoder) {
+                        broadcast_to_clients(group, response);
+                        return;
+                    }
+                    static const jsonScanner fields{"result.bids", "result.asks", "result.change_id", "result.timestamp"};
+                    jsonValue values[4];
+                    fields.scan(response, values);
+                    if (!values[0].found() || !values[1].found()) return;
+
+                    thread_local vector<bookLevel> bids, asks;
+                    thread_local string snapshot, update;
+                    readBookLevels(values[0].raw, bids);
+                    readBookLevels(values[1].raw, asks);
+                    if (encoder->encode(bids, asks, values[2].integer(), values[3].integer(), snapshot, update)) {
+                        broadcast_to_clients(group, update, websocketpp::frame::opcode::binary, snapshot);
+                    }
+                });
+        }
+
+        // Streaming mode: one `book.{symbol}.{interval}` subscription and local book per channel.
+        // Every applied change writes each depth group's top of book once and fans it out.
+        // Analytics groups follow each level change as it is applied and publish their metrics
+        // when they moved. A change_id gap drops the local book and resubscribes, which makes
+        // Deribit resend a snapshot; every group then publishes the rebuilt book in full, as a
+        // snapshot frame for binary groups. Notifications are decoded and the top of book re-encoded
+        // without building a JSON DOM.
+        void stream_from_deribit(const shared_ptr<topic>& group, const groupSpec& spec) {
+            const string channel = "book." + spec.symbol + "." + spec.interval;
+            shared_ptr<streamFeed>& feed = stream_feeds_[feed_key(spec.instrument, spec.interval)];
+            bool first = !feed;
+            if (first) feed = make_shared<streamFeed>(spec.symbol);
+
+            shared_ptr<bookFrameEncoder> encoder;
+            shared_ptr<bookAnalytics> analytics;
+            if (spec.analytics) {
+                analytics = make_shared<bookAnalytics>(spec.instrument, spec.depth);
+            } else if (spec.binary) {
+                encoder = make_shared<bookFrameEncoder>(spec.instrument, spec.depth);
+            }
+            auto groups = make_shared<vector<depthGroup>>(*atomic_load(&feed->groups));
+            groups->push_back({spec.depth, group, encoder, analytics, spec.binary});
+            atomic_store(&feed->groups, shared_ptr<const vector<depthGroup>>(groups));
+            if (!first) return;
+
+            deribitSession& session = upstream_.session_for(spec.symbol);
+            shared_ptr<streamFeed> shared = feed;
+            session.subscribe(channel,
+                [this, &session, channel, shared](string_view data) {
+                    thread_local string encoded, snapshot;   // Reused by every feed on this session's thread
+                    const bookFeed& book = shared->book;
+                    shared_ptr<const vector<depthGroup>> groups = atomic_load(&shared->groups);
+                    unique_lock<mutex> lock(shared->book_mutex_);
+                    feedStatus status = shared->book.apply(data,
+                        [&](bookSide side, double price, size_t rank, double previous, double amount) {
+                            for (auto& entry : *groups) {
+                                if (entry.analytics) entry.analytics->onLevel(book.book(), side, price, rank, previous, amount);
+                            }
+                        });
+                    if (status == feedStatus::snapshot || status == feedStatus::applied) {
+                        shared->updated = deribitSession::receive_time();
+                    }
+                    lock.unlock();   // Only this thread writes the book, so publishing reads it unlocked
+                    switch (status) {
+                        case feedStatus::snapshot:
+                        case feedStatus::applied:
+                            for (auto& entry : *groups) {
+                                if (entry.analytics) {
+                                    // A new group, or a rebuilt book, starts from a full sum
+                                    if (status == feedStatus::snapshot || !entry.analytics->primed()) entry.analytics->rebuild(book.book());
+                                    if (entry.analytics->encode(book.book(), book.instrument(), book.changeId(), book.timestamp(),
+                                                                entry.binary, encoded)) {
+                                        broadcast_to_clients(entry.group, encoded, entry.binary ? websocketpp::frame::opcode::binary
+                                                                                                 : websocketpp::frame::opcode::text);
+                                    }
+                                } else if (!entry.encoder) {
+                                    broadcast_to_clients(entry.group, book.writeTop(entry.depth, encoded));
+                                } else {
+                                    // A rebuilt book reaches binary clients as a full snapshot frame
+                                    if (status == feedStatus::snapshot) entry.encoder->reset();
+                                    if (entry.encoder->encode(book.book(), book.changeId(), book.timestamp(), snapshot, encoded)) {
+                                        broadcast_to_clients(entry.group, encoded, websocketpp::frame::opcode::binary, snapshot);
+                                    }
+                                }
+                            }
+                            break;
+                        case feedStatus::gap:
+                            cerr << "Sequence gap on " << channel << ", resyncing from snapshot" << endl;
+                            session.resubscribe(channel);
+                            break;
+                        case feedStatus::ignored:
+                            break;
+                    }
+                });
+
+            // Replay starts with the first streamed channel, so the log plays from its beginning
+            if (replay_) {
+                replay_->start([this](string_view payload, chrono::steady_clock::time_point received) {
+                    upstream_.deliver(payload, received);
+                });
+            }
+        }
+
+        // ------ Broadcast System ------
+        // The update is serialized and framed once, into a message the publishing thread
+        // recycles, and that one message is shared by every queue and written to every socket
+        // that does not compress. The subscriber list is an immutable snapshot loaded without
+        // a lock; all socket writes happen in drain_client on the server's io threads, or on
+        // the fan-out threads in low-latency mode. Binary deltas pass the matching snapshot
+        // as `resync`.
+        void broadcast_to_clients(const shared_ptr<topic>& group, string_view message,
+                                  websocketpp::frame::opcode::value opcode = websocketpp::frame::opcode::text,
+                                  string_view resync = {}) {
+            shared_ptr<const subscriberList> targets;
+            shared_ptr<const laneLists> lanes;
+            if (fanout_.empty()) {
+                targets = group->subscribers();
+                if (targets->empty()) return;
+            } else {
+                lanes = group->lanes();
+                if (lanes->empty()) return;
+            }
+            payloadPool& pool = threadPayloadPool();
+            sharedPayload payload = pool.make(message, opcode);
+            sharedPayload fallback;
+            if (!resync.empty()) fallback = pool.make(resync, opcode);
+
+            // Latency is measured from when the upstream message arrived on this thread
+            auto received = deribitSession::receive_time();
+            auto now = chrono::steady_clock::now();
+            if (received.time_since_epoch().count() == 0) received = now;
+
+            if (!fanout_.empty()) {
+                hand_to_fanout(fanoutTask{group, move(lanes), move(payload), move(fallback), received});
+                upstream_to_enqueue_.record(now - received);
                 return;
             }
+            for (auto& target : *targets) {
+                if (target.queue->push(group->id(), payload, received, fallback)) {
+                    connection_hdl hdl = target.hdl;
+                    shared_ptr<clientQueue> queue = target.queue;
+                    bool shareFrames = target.shareFrames;
+                    server_.get_io_service().post([this, hdl, queue, shareFrames] { drain_client(hdl, queue, shareFrames); });
+                }
+            }
+            upstream_to_enqueue_.record(now - received);
+        }
 
-            {
-                lock_guard<mutex> lock(subscriptions_mutex_);
-                deribit_connections[symbol] = deribit_client;
+        // Low-latency mode: every fan-out thread with subscribers of the topic gets the update and
+        // serves its own connections. Runs on the ingest thread, the only producer of every ring.
+        // A full ring is waited out rather than dropped, since dropping would silently break
+        // binary delta chains.
+        void hand_to_fanout(const fanoutTask& task) {
+            for (size_t i = 0; i < task.lanes->size() && i < fanout_.size(); ++i) {
+                if ((*task.lanes)[i].empty()) continue;
+                fanoutLane* lane = fanout_[i].get();
+                fanoutTask copy = task;
+                if (lane->ring.tryPush(move(copy))) continue;
+                lane->stalls.fetch_add(1, memory_order_relaxed);
+                while (!lane->ring.tryPush(move(copy))) {
+                    if (!fanout_running_.load(memory_order_acquire)) return;   // Server stopped
+                    cpuRelax();
+                }
             }
+        }
 
-            deribit_client->connect(con);
-            deribit_client->run();  // Start Deribit client event loop
+        // A fan-out thread: queues each update for the connections of its lane and drains them
+        // on this thread, so no io-thread post sits between the update and con->send (which
+        // still hands the write to the connection's strand). clientQueue admits one drain per
+        // connection at a time, so a backed-up client retried on an io thread never races this one.
+        void run_fanout(size_t index) {
+            pinCurrentThread(low_latency_.fanoutCores[index]);
+            fanoutLane& lane = *fanout_[index];
+            adaptiveSpin spin(low_latency_.busyPoll);
+            fanoutTask task;
+            while (fanout_running_.load(memory_order_acquire)) {
+                if (!lane.ring.tryPop(task)) {
+                    spin.idle();
+                    continue;
+                }
+                spin.reset();
+                if (index >= task.lanes->size()) continue;
+                for (auto& target : (*task.lanes)[index]) {
+                    if (target.queue->push(task.group->id(), task.payload, task.received, task.resync)) {
+                        drain_client(target.hdl, target.queue, target.shareFrames);
+                    }
+                }
+                task = fanoutTask();   // Release the payload before idling
+            }
         }
 
-        // ------ Broadcast System ------
-        void broadcast_to_clients(const string& symbol, const string& message) {
-            lock_guard<mutex> lock(subscriptions_mutex_);
-            
-            if (!subscriptions.count(symbol)) return;
+        // Writes pending updates until the queue is empty or the socket backs up. A backed-up
+        // client is retried on a timer; meanwhile newer books conflate into its queue. With
+        // `shareFrames` the publisher's prepared message is queued on the socket itself; a
+        // connection with permessage-deflate frames and compresses its own copy.
+        void drain_client(connection_hdl hdl, shared_ptr<clientQueue> queue, bool shareFrames) {
+            websocketpp::lib::error_code ec;
+            server::connection_ptr con = server_.get_con_from_hdl(hdl, ec);
+            if (ec || con->get_state() != websocketpp::session::state::open) return;  // Client is gone
+
+            if (con->get_buffered_amount() >= MAX_BUFFERED_BYTES) {
+                retry_drain(hdl, queue, shareFrames);
+                return;
+            }
+
+            queuedUpdate update;
+            while (queue->pop(update)) {
+                if (shareFrames) {
+                    con->send(update.payload);
+                } else {
+                    const string& payload = update.payload->get_payload();
+                    con->send(payload.data(), payload.size(), update.payload->get_opcode());
+                }
+                auto latency = chrono::steady_clock::now() - update.enqueued;
+                queue->record_send(latency);
+                upstream_to_send_.record(latency);
 
-            // Send to all subscribed clients
-            for (auto& hdl : subscriptions[symbol]) {
-                server_.send(hdl, message, websocketpp::frame::opcode::text);
+                if (con->get_buffered_amount() >= MAX_BUFFERED_BYTES) {
+                    retry_drain(hdl, queue, shareFrames);
+                    return;
+                }
             }
         }
+
+        void retry_drain(connection_hdl hdl, shared_ptr<clientQueue> queue, bool shareFrames) {
+            server_.set_timer(SLOW_CLIENT_RETRY_MS, [this, hdl, queue, shareFrames](const websocketpp::lib::error_code& ec) {
+                if (!ec) drain_client(hdl, queue, shareFrames);
+            });
+        }
 };
\ No newline at end of file
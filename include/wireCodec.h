@@ -0,0 +1,432 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+#include <initializer_list>
+
+using namespace std;
+
+const size_t REQUEST_BUFFER_RESERVE = 1024;   // Initial capacity of each thread's request buffer
+const size_t MAX_SCAN_PATHS = 64;             // Paths one jsonScanner can look for
+const size_t MAX_SCAN_DEPTH = 64;             // Nesting the scanner follows before giving up
+
+// ------ Encoding ------
+
+// Appends `value` as a quoted JSON string, escaping quotes, backslashes and control characters
+inline void appendJsonString(string& out, string_view value) {
+    static const char HEX[] = "0123456789abcdef";
+    out.push_back('"');
+    size_t run = 0;   // Start of the pending unescaped run
+    for (size_t i = 0; i < value.size(); ++i) {
+        unsigned char c = (unsigned char)value[i];
+        if (c >= 0x20 && c != '"' && c != '\\') continue;
+
+        out.append(value.data() + run, i - run);
+        run = i + 1;
+        switch (c) {
+            case '"':  out.append("\\\""); break;
+            case '\\': out.append("\\\\"); break;
+            case '\n': out.append("\\n"); break;
+            case '\r': out.append("\\r"); break;
+            case '\t': out.append("\\t"); break;
+            case '\b': out.append("\\b"); break;
+            case '\f': out.append("\\f"); break;
+            default:
+                out.append("\\u00");
+                out.push_back(HEX[c >> 4]);
+                out.push_back(HEX[c & 0xF]);
+        }
+    }
+    out.append(value.data() + run, value.size() - run);
+    out.push_back('"');
+}
+
+// Shortest text that round-trips; JSON has no NaN or infinity, so those become null
+inline void appendJsonNumber(string& out, double value) {
+    if (!isfinite(value)) {
+        out.append("null");
+        return;
+    }
+    char buffer[32];
+    auto result = to_chars(buffer, buffer + sizeof(buffer), value);
+    out.append(buffer, result.ptr);
+}
+
+inline void appendJsonNumber(string& out, long long value) {
+    char buffer[24];
+    auto result = to_chars(buffer, buffer + sizeof(buffer), value);
+    out.append(buffer, result.ptr);
+}
+
+// Already encoded JSON, written verbatim by payloadTemplate
+struct rawJson {
+    string_view text;
+};
+
+// Request buffer reused by every encode on this thread. Callers must finish with the
+// payload before encoding another one on the same thread.
+inline string& requestBuffer() {
+    thread_local string buffer = [] {
+        string initial;
+        initial.reserve(REQUEST_BUFFER_RESERVE);
+        return initial;
+    }();
+    return buffer;
+}
+
+// ======== payloadTemplate Class ========
+// A JSON body split once, at construction, into the literal text around each `$`
+// placeholder. render() copies the literals and encodes the arguments straight into a
+// caller-owned buffer, so once the buffer has grown no request allocates. Strings
+// are quoted and escaped, numbers use to_chars and rawJson is copied as is.
+class payloadTemplate {
+    public:
+        explicit payloadTemplate(string_view pattern) {
+            size_t start = 0;
+            for (size_t i = 0; i < pattern.size(); ++i) {
+                if (pattern[i] != '$') continue;
+                pieces_.emplace_back(pattern.substr(start, i - start));
+                start = i + 1;
+            }
+            pieces_.emplace_back(pattern.substr(start));
+        }
+
+        // Replaces the contents of `out` with the rendered payload and returns it
+        template <typename... Args>
+        const string& render(string& out, const Args&... args) const {
+            if (sizeof...(Args) + 1 != pieces_.size()) {
+                throw invalid_argument("payloadTemplate: argument count does not match placeholders");
+            }
+            out.clear();
+            size_t piece = 0;
+            (appendArgument(out, piece, args), ...);
+            out.append(pieces_[piece]);
+            return out;
+        }
+
+    private:
+        vector<string> pieces_;   // Literal text; placeholders sit between consecutive pieces
+
+        template <typename T>
+        void appendArgument(string& out, size_t& piece, const T& value) const {
+            out.append(pieces_[piece++]);
+            encode(out, value);
+        }
+
+        static void encode(string& out, string_view value) { appendJsonString(out, value); }
+        static void encode(string& out, const string& value) { appendJsonString(out, value); }
+        static void encode(string& out, const char* value) { appendJsonString(out, value); }
+        static void encode(string& out, double value) { appendJsonNumber(out, value); }
+        static void encode(string& out, int value) { appendJsonNumber(out, (long long)value); }
+        static void encode(string& out, long value) { appendJsonNumber(out, (long long)value); }
+        static void encode(string& out, long long value) { appendJsonNumber(out, value); }
+        static void encode(string& out, rawJson value) { out.append(value.text); }
+};
+
+// ------ Decoding ------
+
+// Raw text of one value found by jsonScanner; views into the scanned payload
+struct jsonValue {
+    string_view raw;   // Exact value text, quotes included for strings; empty when absent
+
+    bool found() const { return !raw.empty(); }
+    bool isString() const { return raw.size() >= 2 && raw.front() == '"'; }
+    bool isNull() const { return raw == "null"; }
+
+    // String contents without the quotes, escape sequences left as written
+    string_view view() const {
+        return isString() ? raw.substr(1, raw.size() - 2) : raw;
+    }
+
+    // String contents with escape sequences decoded (\uXXXX outside ASCII is kept as written)
+    string text() const {
+        string_view in = view();
+        string out;
+        out.reserve(in.size());
+        for (size_t i = 0; i < in.size(); ++i) {
+            if (in[i] != '\\' || i + 1 == in.size()) {
+                out.push_back(in[i]);
+                continue;
+            }
+            char c = in[++i];
+            switch (c) {
+                case 'n': out.push_back('\n'); break;
+                case 'r': out.push_back('\r'); break;
+                case 't': out.push_back('\t'); break;
+                case 'b': out.push_back('\b'); break;
+                case 'f': out.push_back('\f'); break;
+                case 'u': {
+                    unsigned code = 0;
+                    auto result = (i + 4 < in.size()) ? from_chars(in.data() + i + 1, in.data() + i + 5, code, 16)
+                                                      : from_chars_result{nullptr, errc::invalid_argument};
+                    if (result.ec == errc() && result.ptr == in.data() + i + 5 && code < 0x80) {
+                        out.push_back((char)code);
+                        i += 4;
+                    } else {
+                        out.append("\\u");
+                    }
+                    break;
+                }
+                default: out.push_back(c);   // \" \\ \/
+            }
+        }
+        return out;
+    }
+
+    double number(double fallback = 0) const {
+        double value;
+        auto result = from_chars(raw.data(), raw.data() + raw.size(), value);
+        return (result.ec == errc()) ? value : fallback;
+    }
+
+    long long integer(long long fallback = 0) const {
+        long long value;
+        auto result = from_chars(raw.data(), raw.data() + raw.size(), value);
+        return (result.ec == errc()) ? value : fallback;
+    }
+};
+
+// ======== jsonScanner Class ========
+// Finds the values at a fixed set of paths in one forward pass over a JSON text without
+// building a DOM or allocating. Paths are dot separated object keys and array indexes,
+// e.g. "result.trades.0.order_id". Subtrees no path leads into are skipped by bracket
+// matching, and the scan stops as soon as every path has been found. Keys are compared
+// as written, so paths must not rely on escape sequences in keys.
+class jsonScanner {
+    public:
+        struct cursor {
+            const char* p;
+            const char* end;
+        };
+
+        jsonScanner(initializer_list<string_view> paths) {
+            if (paths.size() > MAX_SCAN_PATHS) throw invalid_argument("jsonScanner: too many paths");
+            for (string_view path : paths) {
+                targets_.emplace_back();
+                target& entry = targets_.back();
+                entry.path = string(path);
+                size_t start = 0;
+                for (size_t i = 0; i <= entry.path.size(); ++i) {
+                    if (i < entry.path.size() && entry.path[i] != '.') continue;
+                    entry.segments.push_back({start, i - start});
+                    start = i + 1;
+                }
+            }
+            all_ = (targets_.size() == 64) ? ~0ULL : ((1ULL << targets_.size()) - 1);
+        }
+
+        size_t size() const {
+            return targets_.size();
+        }
+
+        // Fills out[i] with the value at path i (or leaves it empty). `out` must hold size()
+        // entries. Returns false when the text is not well formed up to the point scanned.
+        bool scan(string_view text, jsonValue* out) const {
+            for (size_t i = 0; i < targets_.size(); ++i) out[i] = jsonValue{};
+            cursor at{text.data(), text.data() + text.size()};
+            uint64_t remaining = all_;
+            skipSpace(at);
+            return value(at, 0, all_, out, remaining) || remaining == 0;
+        }
+
+    private:
+        struct segment {
+            size_t offset;
+            size_t length;
+        };
+        struct target {
+            string path;
+            vector<segment> segments;
+
+            string_view part(size_t depth) const {
+                return string_view(path).substr(segments[depth].offset, segments[depth].length);
+            }
+        };
+        vector<target> targets_;
+        uint64_t all_ = 0;
+
+        // Parses one value at `depth`; `candidates` are paths matching everything above it
+        bool value(cursor& at, size_t depth, uint64_t candidates, jsonValue* out, uint64_t& remaining) const {
+            if (at.p >= at.end) return false;
+            const char* start = at.p;
+
+            uint64_t complete = 0, deeper = 0;
+            for (uint64_t bits = candidates; bits; bits &= bits - 1) {
+                size_t i = lowestBit(bits);
+                if (targets_[i].segments.size() == depth) complete |= 1ULL << i;
+                else deeper |= 1ULL << i;
+            }
+
+            bool ok;
+            if (!deeper || depth >= MAX_SCAN_DEPTH) {
+                ok = skip(at);
+            } else if (*at.p == '{') {
+                ok = object(at, depth, deeper, out, remaining);
+            } else if (*at.p == '[') {
+                ok = array(at, depth, deeper, out, remaining);
+            } else {
+                ok = skip(at);
+            }
+            if (!ok) return false;
+
+            for (uint64_t bits = complete; bits; bits &= bits - 1) {
+                size_t i = lowestBit(bits);
+                out[i].raw = string_view(start, at.p - start);
+                remaining &= ~(1ULL << i);
+            }
+            return true;
+        }
+
+        bool object(cursor& at, size_t depth, uint64_t candidates, jsonValue* out, uint64_t& remaining) const {
+            ++at.p;   // '{'
+            skipSpace(at);
+            if (at.p < at.end && *at.p == '}') {
+                ++at.p;
+                return true;
+            }
+            while (at.p < at.end) {
+                if (*at.p != '"') return false;
+                const char* keyStart = at.p + 1;
+                if (!skipString(at)) return false;
+                string_view key(keyStart, at.p - 1 - keyStart);
+
+                skipSpace(at);
+                if (at.p >= at.end || *at.p != ':') return false;
+                ++at.p;
+                skipSpace(at);
+
+                uint64_t matching = 0;
+                for (uint64_t bits = candidates & remaining; bits; bits &= bits - 1) {
+                    size_t i = lowestBit(bits);
+                    if (targets_[i].part(depth) == key) matching |= 1ULL << i;
+                }
+                if (!value(at, depth + 1, matching, out, remaining)) return false;
+                if (!remaining) return true;   // Everything found; the rest is never read
+
+                if (!separator(at, '}')) return false;
+                if (at.p[-1] == '}') return true;
+            }
+            return false;
+        }
+
+        bool array(cursor& at, size_t depth, uint64_t candidates, jsonValue* out, uint64_t& remaining) const {
+            ++at.p;   // '['
+            skipSpace(at);
+            if (at.p < at.end && *at.p == ']') {
+                ++at.p;
+                return true;
+            }
+            size_t index = 0;
+            while (at.p < at.end) {
+                uint64_t matching = 0;
+                for (uint64_t bits = candidates & remaining; bits; bits &= bits - 1) {
+                    size_t i = lowestBit(bits);
+                    if (isIndex(targets_[i].part(depth), index)) matching |= 1ULL << i;
+                }
+                if (!value(at, depth + 1, matching, out, remaining)) return false;
+                if (!remaining) return true;
+
+                if (!separator(at, ']')) return false;
+                if (at.p[-1] == ']') return true;
+                ++index;
+            }
+            return false;
+        }
+
+        // Consumes whitespace and then either ',' (plus following whitespace) or `close`
+        static bool separator(cursor& at, char close) {
+            skipSpace(at);
+            if (at.p >= at.end) return false;
+            char c = *at.p++;
+            if (c == close) return true;
+            if (c != ',') return false;
+            skipSpace(at);
+            return true;
+        }
+
+        static bool isIndex(string_view part, size_t index) {
+            size_t parsed;
+            auto result = from_chars(part.data(), part.data() + part.size(), parsed);
+            return result.ec == errc() && result.ptr == part.data() + part.size() && parsed == index;
+        }
+
+        static size_t lowestBit(uint64_t bits) {
+            size_t i = 0;
+            while (!(bits & 1)) {
+                bits >>= 1;
+                ++i;
+            }
+            return i;
+        }
+
+    public:
+        // ------ Shared Scanning Primitives ------
+        static void skipSpace(cursor& at) {
+            while (at.p < at.end && (*at.p == ' ' || *at.p == '\n' || *at.p == '\r' || *at.p == '\t')) ++at.p;
+        }
+
+        // Cursor on the opening quote; leaves it just past the closing quote
+        static bool skipString(cursor& at) {
+            for (++at.p; at.p < at.end; ++at.p) {
+                if (*at.p == '\\') {
+                    ++at.p;
+                } else if (*at.p == '"') {
+                    ++at.p;
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        // Skips any value without looking inside it
+        static bool skip(cursor& at) {
+            if (at.p >= at.end) return false;
+            if (*at.p == '"') return skipString(at);
+            if (*at.p != '{' && *at.p != '[') {
+                const char* start = at.p;
+                while (at.p < at.end && *at.p != ',' && *at.p != '}' && *at.p != ']' &&
+                       *at.p != ' ' && *at.p != '\n' && *at.p != '\r' && *at.p != '\t') ++at.p;
+                return at.p > start;
+            }
+            size_t depth = 0;
+            while (at.p < at.end) {
+                char c = *at.p;
+                if (c == '"') {
+                    if (!skipString(at)) return false;
+                    continue;
+                }
+                ++at.p;
+                if (c == '{' || c == '[') ++depth;
+                else if ((c == '}' || c == ']') && --depth == 0) return true;
+            }
+            return false;
+        }
+};
+
+// Calls `visit(jsonValue)` for each element of a JSON array text, e.g. a book side from
+// jsonScanner. Returns false if `array` is not a well formed array.
+template <typename Visitor>
+bool forEachElement(string_view array, Visitor&& visit) {
+    auto at = jsonScanner::cursor{array.data(), array.data() + array.size()};
+    jsonScanner::skipSpace(at);
+    if (at.p >= at.end || *at.p != '[') return false;
+    ++at.p;
+    jsonScanner::skipSpace(at);
+    if (at.p < at.end && *at.p == ']') return true;
+    while (at.p < at.end) {
+        const char* start = at.p;
+        if (!jsonScanner::skip(at)) return false;
+        visit(jsonValue{string_view(start, at.p - start)});
+        jsonScanner::skipSpace(at);
+        if (at.p >= at.end) return false;
+        char c = *at.p++;
+        if (c == ']') return true;
+        if (c != ',') return false;
+        jsonScanner::skipSpace(at);
+    }
+    return false;
+}
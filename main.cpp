@@ -2,14 +2,80 @@
 #include <fstream>
 #include <chrono>
 #include <ctime>
+#include <mutex>
+#include <thread>
 #include "include/deribitApi.h"
 #include "include/webServer.h"
+#include "include/orderScheduler.h"
 
 using namespace std;
 using json = nlohmann::json;
 using namespace std::chrono; // Include for high-precision timing
 
-int main() {
+// Streaming mode: `main --stream <orders.jsonl | ->` sends every line of the file (or stdin),
+// each {"method": ..., "params": {...}}, through the credit scheduler and prints every response
+// as a JSON line. The order book server keeps running and, when ORDER_COMMAND_TOKEN is set,
+// accepts more as `order` commands from local clients.
+int runOrderStream(const string& source) {
+    unordered_map<string, string> env = readEnv(ENV_FIlE);
+    tradeManager trader(env);
+    orderScheduler scheduler(trader, schedulerConfig::fromEnv(env));
+
+    orderBookServer server(env);
+    trader.setBookSource([&server](const string& symbol, long long depth, string& out) {
+        return server.live_book(symbol, depth, out);
+    });
+    server.set_order_handler([&scheduler](const json& request, function<void(const string&)> reply) {
+        scheduler.submit(tradeOp::fromJson(request), move(reply));
+    });
+    server.listen(8080);  // Start listening on port 8080
+    thread serverThread([&server] { server.run(); });
+
+    ifstream file;
+    if (source != "-") {
+        file.open(source);
+        if (!file) {
+            cerr << "Error: Unable to open " << source << endl;
+            server.stop();
+            serverThread.join();
+            return 1;
+        }
+    }
+    istream& input = (source == "-") ? cin : file;
+
+    mutex outputMutex;
+    string line;
+    size_t lineNumber = 0;
+    while (getline(input, line)) {
+        ++lineNumber;
+        if (line.empty()) continue;
+        try {
+            tradeOp op = tradeOp::fromJson(json::parse(line));
+            scheduler.submit(move(op), [lineNumber, &outputMutex](const string& response) {
+                string out = "{\"line\":" + to_string(lineNumber) + ",\"response\":";
+                if (!response.empty() && response[0] == '{') out += response;
+                else appendJsonString(out, response);   // Transport errors are plain text
+                out += "}";
+                lock_guard<mutex> lock(outputMutex);
+                cout << out << endl;
+            });
+        } catch (const exception& e) {
+            cerr << "Skipping line " << lineNumber << ": " << e.what() << endl;
+        }
+    }
+
+    scheduler.drain();
+    cerr << "Order stream finished: " << scheduler.sent() << " requests sent, "
+         << scheduler.rejected() << " rejected with too_many_requests" << endl;
+    serverThread.join();
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    if (argc >= 3 && string(argv[1]) == "--stream") {
+        return runOrderStream(argv[2]);
+    }
+
     tradeManager trader;
 
     // Read input from JSON file
@@ -44,20 +110,16 @@ int main() {
     auto latency = duration_cast<milliseconds>(end_time - start_time).count();
     output["order_placement_latency_ms"] = latency;
 
-    // Parse response
-    json orderResponse = json::parse(response);
-    
-    if (orderResponse.contains("result") && orderResponse["result"].contains("trades")) {
-        output["order_id"] = orderResponse["result"]["trades"][0]["order_id"];
-    } else {
-        output["order_id"] = "N/A";
-    }
-
-    // Get Order Book
-    output["order_book"] = json::parse(trader.getOrderBook(instrument, 1));
+    // Read only the order id from the response
+    static const jsonScanner orderFields{"result.trades.0.order_id"};
+    jsonValue orderId;
+    orderFields.scan(response, &orderId);
+    output["order_id"] = orderId.isString() ? orderId.text() : "N/A";
 
-    // Get Active Positions
-    output["positions"] = json::parse(trader.getPositions());
+    // Get Order Book and Active Positions concurrently
+    vector<string> snapshots = trader.submitBatch({tradeOp::orderBook(instrument, 1), tradeOp::positions()});
+    output["order_book"] = json::parse(snapshots[0]);
+    output["positions"] = json::parse(snapshots[1]);
 
     // Write output to JSON file
     ofstream outputFile("../output.json"); // Update the location of the output file based on the relative path with respect to terminal dir